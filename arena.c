@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <string.h>
+#include "crypto.h"
+#include "arena.h"
+
+#define ARENA_ALIGN         16          // alignment of everything the arena hands out, same as malloc
+#define ARENA_MIN_CLASS     16          // smallest size class, every class is twice the one before
+
+// a bump region, the header keeps the data behind it aligned
+struct arena_block {
+    struct arena_block *next;
+    size_t size;                        // bytes of data
+    size_t used;
+} __attribute__((aligned(ARENA_ALIGN)));
+
+// a freed small allocation waiting in its size class
+struct arena_free {
+    struct arena_free *next;
+};
+
+struct crypto_arena {
+    size_t block_size;
+    struct arena_block *first;          // blocks kept across resets, bumped through in order
+    struct arena_block *current;
+    struct arena_block *large;          // allocations bigger than a block, released on reset
+    struct arena_free *classes[CRYPTO_ARENA_CLASSES];
+};
+
+// arena the library allocates from on this thread, NULL for malloc
+static __thread crypto_arena *arena_current;
+
+/*
+* returns the size class of size bytes, or -1 if it is too big for one
+*/
+static int arena_class(size_t size){
+    size_t class_size;
+    int c;
+
+    for(c = 0, class_size = ARENA_MIN_CLASS; c < CRYPTO_ARENA_CLASSES; c++, class_size *= 2){
+        if(size <= class_size)
+            return c;
+    }
+
+    return -1;
+}
+
+/*
+* allocates a block with size bytes of data, returns NULL if out of memory
+*/
+static struct arena_block *arena_block_new(size_t size){
+    struct arena_block *block;
+
+    block = (struct arena_block*)malloc(sizeof(struct arena_block) + size);
+    if(block == NULL)
+        return NULL;
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+
+    return block;
+}
+
+/*
+* creates an arena growing block_size bytes at a time, 0 uses CRYPTO_ARENA_BLOCK. returns NULL if out of memory
+*/
+crypto_arena *crypto_arena_create(size_t block_size){
+    crypto_arena *arena;
+
+    if(block_size == 0)
+        block_size = CRYPTO_ARENA_BLOCK;
+    block_size = (block_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    arena = (crypto_arena*)calloc(1, sizeof(crypto_arena));
+    if(arena == NULL)
+        return NULL;
+
+    arena->block_size = block_size;
+    arena->first = arena_block_new(block_size);
+    if(arena->first == NULL){
+        free(arena);
+        return NULL;
+    }
+    arena->current = arena->first;
+
+    return arena;
+}
+
+/*
+* frees the arena and everything allocated from it, it stops being current on the calling thread
+*/
+void crypto_arena_destroy(crypto_arena *arena){
+    struct arena_block *block, *next;
+
+    if(arena == NULL)
+        return;
+
+    crypto_arena_reset(arena);
+    for(block = arena->first; block != NULL; block = next){
+        next = block->next;
+        free(block);
+    }
+    if(arena_current == arena)
+        arena_current = NULL;
+    free(arena);
+
+    return;
+}
+
+/*
+* releases everything allocated from the arena at once, keeping its blocks for the next round of allocations
+*/
+void crypto_arena_reset(crypto_arena *arena){
+    struct arena_block *block, *next;
+
+    for(block = arena->large; block != NULL; block = next){
+        next = block->next;
+        free(block);
+    }
+    arena->large = NULL;
+
+    for(block = arena->first; block != NULL; block = block->next)
+        block->used = 0;
+    arena->current = arena->first;
+    memset(arena->classes, 0, sizeof(arena->classes));
+
+    return;
+}
+
+/*
+* returns size bytes aligned like malloc, valid until the next reset. small sizes are rounded up to their size class
+* and reuse what crypto_arena_free gave back, returns NULL if out of memory
+*/
+void *crypto_arena_alloc(crypto_arena *arena, size_t size){
+    struct arena_block *block;
+    struct arena_free *free_data;
+    int c;
+
+    c = arena_class(size);
+    if(c >= 0){
+        free_data = arena->classes[c];
+        if(free_data != NULL){
+            arena->classes[c] = free_data->next;
+            return free_data;
+        }
+        size = (size_t)ARENA_MIN_CLASS << c;
+    }
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    // bigger than a block, it gets one of its own
+    if(size > arena->block_size){
+        block = arena_block_new(size);
+        if(block == NULL)
+            return NULL;
+        block->next = arena->large;
+        arena->large = block;
+        return block + 1;
+    }
+
+    // move on to the next kept block, or grow the chain
+    if(arena->current->used + size > arena->current->size){
+        if(arena->current->next == NULL){
+            block = arena_block_new(arena->block_size);
+            if(block == NULL)
+                return NULL;
+            arena->current->next = block;
+        }
+        arena->current = arena->current->next;
+    }
+
+    block = arena->current;
+    block->used += size;
+
+    return (uint8_t*)(block + 1) + block->used - size;
+}
+
+/*
+* gives size bytes allocated with crypto_arena_alloc back to their size class so the next allocation of the class
+* reuses them, bigger allocations stay until the reset
+*/
+void crypto_arena_free(crypto_arena *arena, void *data, size_t size){
+    struct arena_free *free_data = (struct arena_free*)data;
+    int c;
+
+    c = arena_class(size);
+    if(data == NULL || c < 0)
+        return;
+
+    free_data->next = arena->classes[c];
+    arena->classes[c] = free_data;
+
+    return;
+}
+
+/*
+* makes arena the one the library allocates its results and scratch memory from on the calling thread (NULL goes
+* back to malloc), returns the arena that was current before
+*/
+crypto_arena *crypto_arena_use(crypto_arena *arena){
+    crypto_arena *previous = arena_current;
+
+    arena_current = arena;
+
+    return previous;
+}
+
+/*
+* returns the calling thread's current arena, NULL if the library allocates with malloc
+*/
+crypto_arena *crypto_arena_current(void){
+    return arena_current;
+}
+
+/*
+* size bytes from the calling thread's current arena, or from malloc when it has none
+*/
+void *arena_get(size_t size){
+    if(arena_current != NULL)
+        return crypto_arena_alloc(arena_current, size);
+
+    return malloc(size);
+}
+
+/*
+* gives back size bytes taken with arena_get: small ones go to the arena's size class for reuse before the next reset,
+* malloc'ed ones are freed
+*/
+void arena_put(void *data, size_t size){
+    if(arena_current != NULL)
+        crypto_arena_free(arena_current, data, size);
+    else
+        free(data);
+
+    return;
+}
@@ -0,0 +1,18 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+#include "crypto.h"
+
+/*
+* size bytes from the calling thread's current arena, or from malloc when it has none
+*/
+void *arena_get(size_t size);
+
+/*
+* gives back size bytes taken with arena_get: small ones go to the arena's size class for reuse before the next reset,
+* malloc'ed ones are freed
+*/
+void arena_put(void *data, size_t size);
+
+#endif
@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "crypto.h"
+#include "pool.h"
+#include "batch.h"
+
+// the inputs of a batch, collected up front so outputs written during the run are never picked up as inputs
+struct batch_list {
+    char **paths;                   // where to read each input
+    char **names;                   // where its result goes, relative to the output directory
+    size_t count;
+    size_t capacity;
+};
+
+// everything a worker needs for one file of the batch
+struct batch {
+    struct batch_list *list;
+    const char *outdir;
+    const char *suffix;
+    batch_fn fn;
+    const void *key;
+    batch_stats *stats;
+};
+
+/*
+* appends an input and the name of its result, returns -1 if out of memory
+*/
+static int batch_list_add(struct batch_list *list, const char *path, const char *name){
+    char **paths, **names;
+    size_t capacity;
+
+    if(list->count == list->capacity){
+        capacity = list->capacity ? list->capacity * 2 : 64;
+        paths = realloc(list->paths, capacity * sizeof(char*));
+        if(paths == NULL)
+            return -1;
+        list->paths = paths;
+        names = realloc(list->names, capacity * sizeof(char*));
+        if(names == NULL)
+            return -1;
+        list->names = names;
+        list->capacity = capacity;
+    }
+
+    list->paths[list->count] = strdup(path);
+    list->names[list->count] = strdup(name);
+    if(list->paths[list->count] == NULL || list->names[list->count] == NULL){
+        free(list->paths[list->count]);
+        free(list->names[list->count]);
+        return -1;
+    }
+    list->count++;
+
+    return 0;
+}
+
+/*
+* adds every regular file below dir, rel is the path of dir relative to the batch source ("" at the top).
+* symbolic links are not followed so a link cycle can not send the walk around forever
+*/
+static int batch_list_walk(struct batch_list *list, const char *dir, const char *rel, int depth){
+    struct dirent *entry;
+    struct stat st;
+    char *path, *name;
+    DIR *d;
+    int status = 0;
+
+    if(depth > BATCH_MAX_DEPTH)
+        return 0;
+
+    d = opendir(dir);
+    if(d == NULL)
+        return -1;
+
+    while(status == 0 && (entry = readdir(d)) != NULL){
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        path = malloc(strlen(dir) + strlen(entry->d_name) + 2);
+        name = malloc(strlen(rel) + strlen(entry->d_name) + 2);
+        if(path == NULL || name == NULL){
+            free(path);
+            free(name);
+            status = -1;
+            break;
+        }
+        sprintf(path, "%s/%s", dir, entry->d_name);
+        sprintf(name, "%s%s%s", rel, rel[0] ? "/" : "", entry->d_name);
+
+        if(lstat(path, &st) == 0){
+            if(S_ISDIR(st.st_mode))
+                batch_list_walk(list, path, name, depth + 1);
+            else if(S_ISREG(st.st_mode))
+                status = batch_list_add(list, path, name);
+        }
+
+        free(path);
+        free(name);
+    }
+    closedir(d);
+
+    return status;
+}
+
+/*
+* adds the paths listed one per line in the file source, or in stdin for "-"
+*/
+static int batch_list_read(struct batch_list *list, const char *source){
+    char *line = NULL, *name;
+    size_t size = 0;
+    ssize_t got;
+    FILE *f;
+    int status = 0;
+
+    f = strcmp(source, "-") == 0 ? stdin : fopen(source, "r");
+    if(f == NULL)
+        return -1;
+
+    while(status == 0 && (got = getline(&line, &size, f)) > 0){
+        while(got > 0 && (line[got - 1] == '\n' || line[got - 1] == '\r'))
+            line[--got] = '\0';
+        if(got == 0)
+            continue;
+
+        name = strrchr(line, '/');
+        status = batch_list_add(list, line, name ? name + 1 : line);
+    }
+
+    free(line);
+    if(f != stdin)
+        fclose(f);
+
+    return status;
+}
+
+/*
+* creates the missing directories leading up to the file path
+*/
+static void batch_make_parents(char *path){
+    char *slash;
+
+    for(slash = strchr(path + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')){
+        *slash = '\0';
+        mkdir(path, 0755);
+        *slash = '/';
+    }
+
+    return;
+}
+
+/*
+* transforms in_path into out_path, the input is mapped and the output file mapped shared and grown to the largest
+* possible result, falling back to read() and write() for either. returns -1 if either file failed
+*/
+static int batch_transform(struct batch *batch, const char *in_path, const char *out_path, size_t *read_bytes,
+                           size_t *written_bytes){
+    struct stat in_stat, out_stat;
+    uint8_t *in = NULL, *out = NULL;
+    int infd, outfd = -1, in_mapped = 0, out_mapped = 0, status = -1;
+    size_t length = 0, capacity, size = 0, done;
+    ssize_t got;
+
+    infd = open(in_path, O_RDONLY);
+    if(infd < 0)
+        return -1;
+    if(fstat(infd, &in_stat) != 0 || !S_ISREG(in_stat.st_mode))
+        goto out;
+    length = in_stat.st_size;
+    capacity = length + BATCH_SLACK;
+
+    // truncating an output that is the input itself would lose it
+    outfd = open(out_path, O_RDWR | O_CREAT, 0644);
+    if(outfd < 0 || fstat(outfd, &out_stat) != 0)
+        goto out;
+    if(out_stat.st_dev == in_stat.st_dev && out_stat.st_ino == in_stat.st_ino)
+        goto out;
+
+    if(length > 0){
+        in = mmap(NULL, length, PROT_READ, MAP_PRIVATE | MAP_POPULATE, infd, 0);
+        if(in != MAP_FAILED){
+            madvise(in, length, MADV_SEQUENTIAL);
+            in_mapped = 1;
+        }else{
+            in = malloc(length);
+            if(in == NULL)
+                goto out;
+            for(done = 0; done < length; done += got){
+                got = read(infd, in + done, length - done);
+                if(got < 0 && errno == EINTR){
+                    got = 0;
+                    continue;
+                }
+                if(got <= 0)
+                    goto out;
+            }
+        }
+    }
+
+    if(ftruncate(outfd, capacity) == 0){
+        out = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, outfd, 0);
+        if(out != MAP_FAILED)
+            out_mapped = 1;
+    }
+    if(!out_mapped){
+        out = malloc(capacity);
+        if(out == NULL)
+            goto out;
+    }
+
+    if(length > 0)
+        size = batch->fn(batch->key, in, out, length);
+
+    if(out_mapped){
+        munmap(out, capacity);
+        out = NULL;
+        if(ftruncate(outfd, size) != 0)
+            goto out;
+    }else{
+        if(ftruncate(outfd, 0) != 0 || lseek(outfd, 0, SEEK_SET) != 0)
+            goto out;
+        for(done = 0; done < size; done += got){
+            got = write(outfd, out + done, size - done);
+            if(got < 0 && errno == EINTR){
+                got = 0;
+                continue;
+            }
+            if(got <= 0)
+                goto out;
+        }
+    }
+
+    *read_bytes = length;
+    *written_bytes = size;
+    status = 0;
+
+out:
+    if(in_mapped)
+        munmap(in, length);
+    else
+        free(in);
+    if(!out_mapped)
+        free(out);
+    if(outfd >= 0)
+        close(outfd);
+    close(infd);
+
+    return status;
+}
+
+/*
+* pool chunk function, one chunk is one file of the batch
+*/
+static void batch_file(void *arg, size_t chunk){
+    struct batch *batch = (struct batch*)arg;
+    const char *path = batch->list->paths[chunk];
+    const char *name = batch->list->names[chunk];
+    size_t read_bytes = 0, written_bytes = 0;
+    char *out_path;
+
+    if(batch->outdir != NULL){
+        out_path = malloc(strlen(batch->outdir) + strlen(name) + 2);
+        if(out_path != NULL){
+            sprintf(out_path, "%s/%s", batch->outdir, name);
+            batch_make_parents(out_path);
+        }
+    }else{
+        out_path = malloc(strlen(path) + strlen(batch->suffix) + 1);
+        if(out_path != NULL)
+            sprintf(out_path, "%s%s", path, batch->suffix);
+    }
+
+    if(out_path == NULL || batch_transform(batch, path, out_path, &read_bytes, &written_bytes) != 0){
+        fprintf(stderr, "error: could not transform %s\n", path);
+        __atomic_fetch_add(&batch->stats->failed, 1, __ATOMIC_RELAXED);
+    }else{
+        __atomic_fetch_add(&batch->stats->read, read_bytes, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&batch->stats->written, written_bytes, __ATOMIC_RELAXED);
+    }
+    free(out_path);
+
+    return;
+}
+
+/*
+* runs fn over every input of source: every regular file below it when it is a directory, otherwise the paths
+* listed in it one per line ("-" reads the list from stdin). the files are spread over threads workers.
+* with outdir the results go to outdir under their path relative to the directory (their base name for a list),
+* without it next to each input with suffix appended. returns -1 if source could not be read, 0 otherwise
+*/
+int batch_run(const char *source, const char *outdir, const char *suffix, int threads, batch_fn fn, const void *key,
+              batch_stats *stats){
+    struct batch_list list = { NULL, NULL, 0, 0 };
+    struct timespec start, end;
+    struct batch batch;
+    struct stat st;
+    crypto_pool *pool;
+    size_t i;
+    int status;
+
+    memset(stats, 0, sizeof(batch_stats));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if(strcmp(source, "-") != 0 && stat(source, &st) == 0 && S_ISDIR(st.st_mode))
+        status = batch_list_walk(&list, source, "", 0);
+    else
+        status = batch_list_read(&list, source);
+
+    if(status == 0){
+        if(outdir != NULL)
+            mkdir(outdir, 0755);
+
+        batch.list = &list;
+        batch.outdir = outdir;
+        batch.suffix = suffix;
+        batch.fn = fn;
+        batch.key = key;
+        batch.stats = stats;
+        stats->files = list.count;
+
+        // whole files are the pool chunks, so a worker done early steals the files of a slower one
+        pool = threads > 1 ? crypto_pool_create(threads) : NULL;
+        if(pool != NULL){
+            pool_run(pool, list.count, batch_file, &batch);
+            crypto_pool_destroy(pool);
+        }else{
+            for(i = 0; i < list.count; i++)
+                batch_file(&batch, i);
+        }
+    }
+
+    for(i = 0; i < list.count; i++){
+        free(list.paths[i]);
+        free(list.names[i]);
+    }
+    free(list.paths);
+    free(list.names);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    return status;
+}
+
+/*
+* prints the aggregated throughput of a batch run
+*/
+void batch_report(FILE *f, const batch_stats *stats){
+    double seconds = stats->seconds > 0 ? stats->seconds : 1e-9;
+
+    fprintf(f, "================================================\n");
+    fprintf(f, "| Files    : %zu (%zu failed)\n", stats->files, stats->failed);
+    fprintf(f, "| Read     : %llu bytes\n", stats->read);
+    fprintf(f, "| Written  : %llu bytes\n", stats->written);
+    fprintf(f, "| Time     : %.3f s\n", stats->seconds);
+    fprintf(f, "| Rate     : %.1f MB/s, %.1f files/s\n", stats->read / seconds / 1e6, stats->files / seconds);
+    fprintf(f, "================================================\n");
+
+    return;
+}
@@ -0,0 +1,40 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define BATCH_SLACK         64          // extra output room per file over its input size (playfair padding)
+#define BATCH_MAX_DEPTH     64          // directory levels followed below the source
+
+/*
+* transform of one whole file with a key set up once for the batch: writes at most size + BATCH_SLACK bytes of
+* in into out and returns the bytes written
+*/
+typedef size_t (*batch_fn)(const void *key, uint8_t *in, uint8_t *out, size_t size);
+
+// totals of a batch run
+typedef struct {
+    size_t files;                   // inputs found
+    size_t failed;                  // inputs that could not be read or written
+    unsigned long long read;        // bytes of input transformed
+    unsigned long long written;     // bytes of output written
+    double seconds;                 // wall time of the whole run
+} batch_stats;
+
+/*
+* runs fn over every input of source: every regular file below it when it is a directory, otherwise the paths
+* listed in it one per line ("-" reads the list from stdin). the files are spread over threads workers.
+* with outdir the results go to outdir under their path relative to the directory (their base name for a list),
+* without it next to each input with suffix appended. returns -1 if source could not be read, 0 otherwise
+*/
+int batch_run(const char *source, const char *outdir, const char *suffix, int threads, batch_fn fn, const void *key,
+              batch_stats *stats);
+
+/*
+* prints the aggregated throughput of a batch run
+*/
+void batch_report(FILE *f, const batch_stats *stats);
+
+#endif
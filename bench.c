@@ -0,0 +1,412 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "crypto.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_X86 1
+#endif
+
+#define BENCH_MIN_SIZE      64
+#define BENCH_MAX_SIZE      (1UL << 30)     // largest size -max accepts
+#define BENCH_DEFAULT_MAX   (64UL << 20)    // sizes past this are opt in, the buffers need 3x the memory
+#define BENCH_MIN_NS        50000000ULL     // keep repeating a case for at least this long
+#define BENCH_MAX_REPS      100000
+#define BENCH_NONCE         0x6a09e667              // counter mode nonce, fixed so runs compare
+#define BENCH_EVICT_SIZE    (64 << 20)      // scratch written over for a cold pass where clflush is missing
+
+// one benchmarked function, run over size bytes of in into out
+typedef struct bench_case {
+    const char *cipher;
+    const char *op;
+    size_t (*run)(uint8_t *in, uint8_t *out, size_t size);
+    size_t (*prepare)(uint8_t *in, uint8_t *out, size_t size);  // makes a decrypt's input, NULL for encrypt
+} bench_case;
+
+// one measured row
+typedef struct bench_result {
+    const bench_case *c;
+    const char *pass;
+    size_t size;
+    unsigned long reps;
+    double mbs;
+    double ns_byte;
+    double cycles_byte;
+    double allocs;
+    long rss_kb;
+} bench_result;
+
+enum { FORMAT_TABLE, FORMAT_CSV, FORMAT_JSON };
+
+// allocations made through malloc/calloc/realloc, counted by the --wrap linker option of make bench
+static unsigned long bench_allocs;
+
+static crypto_pool *pool;
+static affine_key ak;
+static playfair_key pk;
+static uint8_t *otp_key;
+static uint8_t *feistel_keys[FEISTEL_ROUNDS];
+static uint8_t feistel_key_bytes[FEISTEL_ROUNDS][FEISTEL_BLOCK_SIZE / 2];
+static feistel_params feistel_wide, feistel_huge;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size){
+    __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size){
+    __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size){
+    __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+/*
+* monotonic time in nanoseconds
+*/
+static uint64_t bench_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+* time stamp counter, 0 where there is none so cycles/byte reads 0
+*/
+static uint64_t bench_cycles(void){
+#ifdef BENCH_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/*
+* peak resident set of the process so far in KiB
+*/
+static long bench_rss_kb(void){
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss;
+}
+
+/*
+* pushes size bytes of data out of every cache level before a cold pass
+*/
+static void bench_evict(const uint8_t *data, size_t size){
+#ifdef BENCH_X86
+    size_t i;
+
+    for(i = 0; i < size; i += 64)
+        _mm_clflush(data + i);
+    _mm_mfence();
+#else
+    static uint8_t *evict_scratch;
+    size_t i;
+
+    if(evict_scratch == NULL)
+        evict_scratch = (uint8_t*)malloc(BENCH_EVICT_SIZE);
+    for(i = 0; i < BENCH_EVICT_SIZE; i += 64)
+        evict_scratch[i]++;
+#endif
+
+    return;
+}
+
+static size_t run_caesar_enc(uint8_t *in, uint8_t *out, size_t size){
+    return caesar_encrypt_par(pool, in, out, 3, size);
+}
+
+static size_t run_caesar_dec(uint8_t *in, uint8_t *out, size_t size){
+    return caesar_decrypt_par(pool, in, out, 3, size);
+}
+
+static size_t run_affine_enc(uint8_t *in, uint8_t *out, size_t size){
+    return affine_encrypt_par(pool, in, out, &ak, size);
+}
+
+static size_t run_affine_dec(uint8_t *in, uint8_t *out, size_t size){
+    return affine_decrypt_par(pool, in, out, &ak, size);
+}
+
+static size_t run_otp_enc(uint8_t *in, uint8_t *out, size_t size){
+    return otp_encrypt_par(pool, in, out, otp_key, size);
+}
+
+static size_t run_otp_dec(uint8_t *in, uint8_t *out, size_t size){
+    return otp_decrypt_par(pool, in, out, otp_key, size);
+}
+
+static size_t run_playfair_enc(uint8_t *in, uint8_t *out, size_t size){
+    return playfair_encrypt_par(pool, in, out, &pk, size);
+}
+
+static size_t run_playfair_dec(uint8_t *in, uint8_t *out, size_t size){
+    return playfair_decrypt_par(pool, in, out, &pk, size);
+}
+
+static size_t run_feistel_enc(uint8_t *in, uint8_t *out, size_t size){
+    return feistel_encrypt_par(pool, in, out, feistel_keys, size);
+}
+
+static size_t run_feistel_dec(uint8_t *in, uint8_t *out, size_t size){
+    return feistel_decrypt_par(pool, in, out, feistel_keys, size);
+}
+
+static size_t run_feistel_ctr_enc(uint8_t *in, uint8_t *out, size_t size){
+    return feistel_ctr_encrypt_par(pool, in, out, feistel_keys, BENCH_NONCE, size);
+}
+
+static size_t run_feistel_ctr_dec(uint8_t *in, uint8_t *out, size_t size){
+    return feistel_ctr_decrypt_par(pool, in, out, feistel_keys, BENCH_NONCE, size);
+}
+
+static size_t run_feistel16_enc(uint8_t *in, uint8_t *out, size_t size){
+    return feistel_params_encrypt_par(pool, in, out, &feistel_wide, size);
+}
+
+static size_t run_feistel16_dec(uint8_t *in, uint8_t *out, size_t size){
+    return feistel_params_decrypt_par(pool, in, out, &feistel_wide, size);
+}
+
+static size_t run_feistel32_enc(uint8_t *in, uint8_t *out, size_t size){
+    return feistel_params_encrypt_par(pool, in, out, &feistel_huge, size);
+}
+
+static size_t run_feistel32_dec(uint8_t *in, uint8_t *out, size_t size){
+    return feistel_params_decrypt_par(pool, in, out, &feistel_huge, size);
+}
+
+static const bench_case cases[] = {
+    {"caesar", "encrypt", run_caesar_enc, NULL},
+    {"caesar", "decrypt", run_caesar_dec, run_caesar_enc},
+    {"affine", "encrypt", run_affine_enc, NULL},
+    {"affine", "decrypt", run_affine_dec, run_affine_enc},
+    {"otp", "encrypt", run_otp_enc, NULL},
+    {"otp", "decrypt", run_otp_dec, run_otp_enc},
+    {"playfair", "encrypt", run_playfair_enc, NULL},
+    {"playfair", "decrypt", run_playfair_dec, run_playfair_enc},
+    {"feistel", "encrypt", run_feistel_enc, NULL},
+    {"feistel", "decrypt", run_feistel_dec, run_feistel_enc},
+    {"feistel-ctr", "encrypt", run_feistel_ctr_enc, NULL},
+    {"feistel-ctr", "decrypt", run_feistel_ctr_dec, run_feistel_ctr_enc},
+    {"feistel-16", "encrypt", run_feistel16_enc, NULL},
+    {"feistel-16", "decrypt", run_feistel16_dec, run_feistel16_enc},
+    {"feistel-32", "encrypt", run_feistel32_enc, NULL},
+    {"feistel-32", "decrypt", run_feistel32_dec, run_feistel32_enc},
+};
+
+/*
+* measures one case at one size, warm runs once untimed first, cold flushes in and out before every timed run
+*/
+static void bench_measure(const bench_case *c, uint8_t *in, uint8_t *out, uint8_t *src, size_t size, int cold, bench_result *res){
+    uint64_t start, elapsed, cycles, t0, c0;
+    unsigned long reps, allocs;
+    size_t bytes;
+
+    // decrypt benches run on real ciphertext
+    bytes = size;
+    if(c->prepare)
+        bytes = c->prepare(src, in, size);
+    else
+        memcpy(in, src, size);
+
+    if(!cold)
+        c->run(in, out, bytes);
+
+    elapsed = 0;
+    cycles = 0;
+    reps = 0;
+    allocs = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED);
+    start = bench_ns();
+    do{
+        if(cold){
+            bench_evict(in, bytes);
+            bench_evict(out, FEISTEL_PADDED_SIZE(bytes) + 2);
+        }
+
+        t0 = bench_ns();
+        c0 = bench_cycles();
+        c->run(in, out, bytes);
+        cycles += bench_cycles() - c0;
+        elapsed += bench_ns() - t0;
+        reps++;
+    }while(bench_ns() - start < BENCH_MIN_NS && reps < BENCH_MAX_REPS);
+    allocs = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED) - allocs;
+
+    res->c = c;
+    res->pass = cold ? "cold" : "warm";
+    res->size = size;
+    res->reps = reps;
+    res->ns_byte = (double)elapsed / ((double)reps * size);
+    res->mbs = 1000.0 / res->ns_byte;
+    res->cycles_byte = (double)cycles / ((double)reps * size);
+    res->allocs = (double)allocs / reps;
+    res->rss_kb = bench_rss_kb();
+
+    return;
+}
+
+/*
+* prints one row in the chosen format, first tells the json printer to skip the separating comma
+*/
+static void bench_print(const bench_result *res, int format, int first){
+    switch(format){
+    case FORMAT_CSV:
+        printf("%s,%s,%s,%zu,%lu,%.2f,%.4f,%.4f,%.2f,%ld\n", res->c->cipher, res->c->op, res->pass, res->size, res->reps,
+               res->mbs, res->ns_byte, res->cycles_byte, res->allocs, res->rss_kb);
+        break;
+    case FORMAT_JSON:
+        printf("%s  {\"cipher\": \"%s\", \"op\": \"%s\", \"pass\": \"%s\", \"size\": %zu, \"reps\": %lu, \"mb_s\": %.2f, "
+               "\"ns_byte\": %.4f, \"cycles_byte\": %.4f, \"allocs_call\": %.2f, \"peak_rss_kb\": %ld}",
+               first ? "" : ",\n", res->c->cipher, res->c->op, res->pass, res->size, res->reps, res->mbs, res->ns_byte,
+               res->cycles_byte, res->allocs, res->rss_kb);
+        break;
+    default:
+        printf("%-11s %-8s %-5s %11zu %8lu %10.2f %9.4f %9.4f %8.2f %10ld\n", res->c->cipher, res->c->op, res->pass,
+               res->size, res->reps, res->mbs, res->ns_byte, res->cycles_byte, res->allocs, res->rss_kb);
+        break;
+    }
+
+    return;
+}
+
+/*
+* parses a size with an optional K, M or G suffix
+*/
+static size_t bench_parse_size(const char *arg){
+    char *end;
+    size_t size;
+
+    size = strtoull(arg, &end, 10);
+    switch(*end){
+    case 'k': case 'K': size <<= 10; break;
+    case 'm': case 'M': size <<= 20; break;
+    case 'g': case 'G': size <<= 30; break;
+    }
+
+    return size;
+}
+
+int main(int argc, char **argv){
+    int i, format, passes, pass, threads, first;
+    const char *only;
+    uint8_t *src, *in, *out;
+    size_t max, size, c;
+    bench_result res;
+
+    format = FORMAT_TABLE;
+    passes = 3;             // bit 0 warm, bit 1 cold
+    max = BENCH_DEFAULT_MAX;
+    threads = 1;
+    only = NULL;
+
+    for(i = 1; i < argc; i++){
+        if(strcmp("-csv", argv[i]) == 0){
+            format = FORMAT_CSV;
+        }else if(strcmp("-json", argv[i]) == 0){
+            format = FORMAT_JSON;
+        }else if(strcmp("-warm", argv[i]) == 0){
+            passes = 1;
+        }else if(strcmp("-cold", argv[i]) == 0){
+            passes = 2;
+        }else if(strcmp("-max", argv[i]) == 0 && i + 1 < argc){
+            max = bench_parse_size(argv[++i]);
+        }else if(strcmp("-threads", argv[i]) == 0 && i + 1 < argc){
+            threads = atoi(argv[++i]);
+        }else if(strcmp("-cipher", argv[i]) == 0 && i + 1 < argc){
+            only = argv[++i];
+        }else{
+            printf("usage: ./bench [-csv | -json] [-warm | -cold] [-max SIZE[K|M|G]] [-threads N] [-cipher NAME]\n");
+            exit(0);
+        }
+    }
+
+    if(max < BENCH_MIN_SIZE)
+        max = BENCH_MIN_SIZE;
+    if(max > BENCH_MAX_SIZE)
+        max = BENCH_MAX_SIZE;
+
+    // fixed seed so every run benches the same keys and text
+    random_key_seed(1);
+    if(threads > 1)
+        pool = crypto_pool_create(threads);
+
+    affine_key_init(&ak, AFFINE_MULT, AFFINE_INC);
+    playfair_key_init(&pk, (uint8_t*)"MONARCHY", 1);
+    for(i = 0; i < FEISTEL_ROUNDS; i++)
+        feistel_keys[i] = feistel_key_bytes[i];
+    feistel_params_init(&feistel_wide, 16, FEISTEL_ROUNDS);
+    feistel_params_init(&feistel_huge, 32, FEISTEL_ROUNDS);
+
+    src = (uint8_t*)malloc(max);
+    in = (uint8_t*)malloc(FEISTEL_PADDED_SIZE(max) + FEISTEL_MAX_BLOCK);
+    out = (uint8_t*)malloc(FEISTEL_PADDED_SIZE(max) + FEISTEL_MAX_BLOCK);
+    otp_key = random_key_create(max);
+    if(src == NULL || in == NULL || out == NULL || otp_key == NULL){
+        printf("error: could not allocate %zu byte buffers\n", max);
+        exit(0);
+    }
+
+    // uppercase text with spaces so the letter filtering ciphers see realistic input
+    random_key_fill(src, max);
+    for(size = 0; size < max; size++)
+        src[size] = (src[size] % 6 == 0) ? ' ' : 'A' + (src[size] % 26);
+
+    switch(format){
+    case FORMAT_CSV:
+        printf("cipher,op,pass,size,reps,mb_s,ns_byte,cycles_byte,allocs_call,peak_rss_kb\n");
+        break;
+    case FORMAT_JSON:
+        printf("{\"simd\": \"%s\", \"threads\": %d, \"results\": [\n", crypto_simd_name(), threads);
+        break;
+    default:
+        printf("simd kernels: %s, threads: %d\n", crypto_simd_name(), threads);
+        printf("%-11s %-8s %-5s %11s %8s %10s %9s %9s %8s %10s\n", "cipher", "op", "pass", "size", "reps", "MB/s",
+               "ns/B", "cycles/B", "allocs", "rss KiB");
+        break;
+    }
+
+    first = 1;
+    for(c = 0; c < sizeof(cases) / sizeof(cases[0]); c++){
+        if(only && strcmp(only, cases[c].cipher) != 0)
+            continue;
+
+        for(size = BENCH_MIN_SIZE; size <= max; size *= 4){
+            for(pass = 0; pass < 2; pass++){
+                if(!(passes & (1 << pass)))
+                    continue;
+
+                bench_measure(&cases[c], in, out, src, size, pass, &res);
+                bench_print(&res, format, first);
+                first = 0;
+            }
+        }
+    }
+
+    if(format == FORMAT_JSON)
+        printf("\n]}\n");
+
+    crypto_pool_destroy(pool);
+    free(src);
+    free(in);
+    free(out);
+    free(otp_key);
+
+    return 0;
+}
@@ -2,39 +2,66 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "crypto.h"
+#include "pipeline.h"
+#include "batch.h"
+
+#define CRACK_SHOW          5       // ranked keys -crack prints
+#define CRACK_PREVIEW       48      // bytes of the input decrypted under each of them
+#define CRACK_CHAINS        4       // fewest playfair annealing chains, more with more threads
 
 void print_full(FILE* f, uint8_t *buffer, uint8_t *encrypted, uint8_t *decrypted, char *alg);
+void affine_args(int argc, char **argv, affine_key *ak);
+void print_stats(FILE *f);
+void pipeline_finish(long long written);
+size_t pipe_caesar_update(void *ctx, uint8_t *in, uint8_t *out, size_t size);
+size_t pipe_caesar_final(void *ctx, uint8_t *out);
+size_t pipe_affine_update(void *ctx, uint8_t *in, uint8_t *out, size_t size);
+size_t pipe_affine_final(void *ctx, uint8_t *out);
+size_t pipe_playfair_update(void *ctx, uint8_t *in, uint8_t *out, size_t size);
+size_t pipe_playfair_final(void *ctx, uint8_t *out);
+int batch_main(int argc, char **argv, int encrypting);
+int crack_main(int argc, char **argv);
+size_t batch_caesar_encrypt(const void *key, uint8_t *in, uint8_t *out, size_t size);
+size_t batch_caesar_decrypt(const void *key, uint8_t *in, uint8_t *out, size_t size);
+size_t batch_affine_encrypt(const void *key, uint8_t *in, uint8_t *out, size_t size);
+size_t batch_affine_decrypt(const void *key, uint8_t *in, uint8_t *out, size_t size);
+size_t batch_playfair_encrypt(const void *key, uint8_t *in, uint8_t *out, size_t size);
+size_t batch_playfair_decrypt(const void *key, uint8_t *in, uint8_t *out, size_t size);
+uint8_t *input_open(int fd, size_t length, int copy);
+uint8_t *output_open(int fd, size_t capacity, int *mapped);
+void output_close(int fd, uint8_t *data, size_t capacity, size_t size, int mapped);
+void write_all(int fd, uint8_t *data, size_t size);
 
 int main(int argc, char** argv){
-    FILE *f, *out;
-    int i, z, len, caesar = 0, affine = 0, otp = 0, playfair = 0, feistel = 0, redirecting = 0, encrypting = 0, full = 0;
+    FILE *out;
+    struct stat in_stat, out_stat;
+    int fd, outfd, mapped, copy, pipelined = 0, batching = 0, cracking = 0, stats = 0;
+    int i, z, threads = 1, caesar = 0, affine = 0, otp = 0, playfair = 0, feistel = 0, redirecting = 0, encrypting = 0, full = 0;
     char *buffer = 0;
-    uint8_t *decrypted, *encrypted, *key, **keys;
-    long length;
+    uint8_t *decrypted, *encrypted, *result, *key, **keys;
+    playfair_key pk;
+    affine_key ak;
+    caesar_ctx cc;
+    affine_ctx ac;
+    playfair_ctx pc;
+    crypto_pool *pool = NULL;
+    crypto_arena *arena = NULL;
+    size_t length, size, capacity;
 
     if(argc < 3){
-        printf("error: usage: ./cipher input [-c | -a | -o | -p | -f] [cipher args] [-ENC | -DEC] [-out outputfile]\n");
+        printf("error: usage: ./cipher input [-c | -a | -o | -p | -f] [cipher args] [-ENC | -DEC] [-out outputfile] [-threads N] [-pipeline] [-stats]\n"
+               "       ./cipher dir | list [-c | -a | -p] [cipher args] [-ENC | -DEC] -batch [-outdir dir] [-threads N] [-stats]\n"
+               "       ./cipher input [-c | -a | -p] -crack [-quadgrams file] [-chains N] [-out outputfile] [-threads N]\n");
         exit(0);
     }
     
-    // Read file
-    f = fopen(argv[1], "rb");
-    if(f){
-        fseek(f, 0, SEEK_END);
-        length = ftell(f);
-        fseek(f, 0, SEEK_SET);
-        buffer = malloc(length);
-        if(buffer){
-            fread(buffer, 1, length, f);
-            fclose(f);
-        }else{
-            printf("error: could not read from file\n");
-            fclose(f);
-            exit(0);
-        }
-    }
-
     // Get wether encrypting, decrypting or full
     full = 1;
     for(i = 0; i < argc; i++){
@@ -44,11 +71,59 @@ int main(int argc, char** argv){
         }else if(strcmp("-DEC", argv[i]) == 0){
             full = 0;
             encrypting = 0;
+        }else if(strcmp("-pipeline", argv[i]) == 0){
+            pipelined = 1;
+        }else if(strcmp("-batch", argv[i]) == 0){
+            batching = 1;
+        }else if(strcmp("-stats", argv[i]) == 0){
+            stats = 1;
+        }else if(strcmp("-crack", argv[i]) == 0){
+            cracking = 1;
+        }
+    }
+
+    if(cracking){
+        if(!full || pipelined || batching){
+            printf("error: -crack takes no -ENC, -DEC, -pipeline or -batch\n");
+            exit(0);
+        }
+        crack_main(argc, argv);
+        if(stats)
+            print_stats(stderr);
+        return 0;
+    }
+
+    if(batching){
+        if(full || pipelined){
+            printf("error: -batch requires -ENC or -DEC and no -pipeline\n");
+            exit(0);
         }
+        batch_main(argc, argv, encrypting);
+        if(stats)
+            print_stats(stderr);
+        return 0;
     }
 
+    if(pipelined && full){
+        printf("error: -pipeline requires -ENC or -DEC\n");
+        exit(0);
+    }
+
+    // Open input, -ENC/-DEC map it as it is while full prints need a null terminated copy
+    fd = open(argv[1], O_RDONLY);
+    if(fd < 0 || fstat(fd, &in_stat) != 0){
+        printf("error: could not open input file\n");
+        exit(0);
+    }
+    length = in_stat.st_size;
+
+    // results are at most one byte longer than the input (playfair X padding) plus the feistel block padding
+    capacity = FEISTEL_PADDED_SIZE(length) + 2;
+
     // Check if we're redirecting
     out = stdout;
+    outfd = STDOUT_FILENO;
+    copy = full;
     for(i = 0; i < argc; i++){
         if(strcmp("-out", argv[i]) == 0){
             redirecting = 1;
@@ -58,13 +133,82 @@ int main(int argc, char** argv){
             }
 
             // Get file
-            out = fopen(argv[i + 1], "w");
-            if(!out){
-                printf("error: could not open output file for writting\n");
+            if(full){
+                out = fopen(argv[i + 1], "w");
+                if(!out){
+                    printf("error: could not open output file for writting\n");
+                    exit(0);
+                }
+            }else{
+                outfd = open(argv[i + 1], O_RDWR | O_CREAT, 0644);
+                if(outfd < 0 || fstat(outfd, &out_stat) != 0){
+                    printf("error: could not open output file for writting\n");
+                    exit(0);
+                }
+
+                // writing over the input itself, it has to be read before the output replaces it
+                if(out_stat.st_dev == in_stat.st_dev && out_stat.st_ino == in_stat.st_ino){
+                    if(pipelined){
+                        printf("error: -pipeline cannot write over its own input\n");
+                        exit(0);
+                    }
+                    copy = 1;
+                }
+            }
+            break;
+        }
+    }
+
+    // -pipeline streams from fd chunk by chunk instead of taking the input in whole
+    if(!pipelined){
+        buffer = (char*)input_open(fd, length, copy);
+        if(buffer == NULL){
+            printf("error: could not read from file\n");
+            exit(0);
+        }
+        close(fd);
+    }else if(!S_ISREG(in_stat.st_mode)){
+        printf("error: -pipeline requires a regular input file\n");
+        exit(0);
+    }
+
+    // the input is safe in memory now, the output starts empty like fopen "w". devices and pipes can not be truncated
+    // and have no old bytes to leave behind, a regular file that keeps them would end in stale data
+    if(redirecting && !full && ftruncate(outfd, 0) != 0 && S_ISREG(out_stat.st_mode)){
+        printf("error: could not truncate output file\n");
+        exit(0);
+    }
+
+    // -ENC/-DEC transform straight into the mapped output file, or into memory written out with write()
+    result = NULL;
+    mapped = 0;
+    if(!full && !pipelined){
+        result = output_open(redirecting ? outfd : -1, capacity, &mapped);
+        if(result == NULL){
+            printf("error: could not allocate output\n");
+            exit(0);
+        }
+    }
+
+    // Get worker threads for the ciphers that can split their input
+    for(i = 0; i < argc; i++){
+        if(strcmp("-threads", argv[i]) == 0){
+            if(argc < i + 2 || atoi(argv[i + 1]) < 1){
+                printf("error: -threads requires extra argument: number of threads\n");
+                exit(0);
             }
+            threads = atoi(argv[i + 1]);
             break;
         }
     }
+    if(threads > 1)
+        pool = crypto_pool_create(threads);
+
+    // full prints go through the allocating functions, their results and key matrices all come from one arena
+    if(full){
+        arena = crypto_arena_create(0);
+        crypto_arena_use(arena);
+    }
 
     // Get cipher arg
     if(argv[2][0] != '-' || strlen(argv[2]) < 2){
@@ -82,31 +226,39 @@ int main(int argc, char** argv){
         }
 
         if(full){
-            encrypted = caesar_encrypt(buffer, atoi(argv[3]));
-            decrypted = caesar_decrypt(encrypted, atoi(argv[3]));
+            encrypted = caesar_encrypt(buffer, atoi(argv[3]), length);
+            decrypted = caesar_decrypt(encrypted, atoi(argv[3]), length);
             print_full(out, buffer, encrypted, decrypted, "Caesar's Cipher");
+        }else if(pipelined){
+            caesar_ctx_init(&cc, atoi(argv[3]), !encrypting);
+            pipeline_finish(pipeline_run(fd, outfd, pipe_caesar_update, pipe_caesar_final, &cc));
         }else if(encrypting){
-            encrypted = caesar_encrypt(buffer, atoi(argv[3]));
-            fprintf(out, (char*)encrypted);
+            size = caesar_encrypt_par(pool, buffer, result, atoi(argv[3]), length);
+            output_close(outfd, result, capacity, size, mapped);
         }else{
-            decrypted = caesar_decrypt(buffer, atoi(argv[3]));
-            fprintf(out, (char*)decrypted);
+            size = caesar_decrypt_par(pool, buffer, result, atoi(argv[3]), length);
+            output_close(outfd, result, capacity, size, mapped);
         }
 
         break;
     case 'a':
         affine = 1;
 
+        affine_args(argc, argv, &ak);
+
         if(full){
-            encrypted = affine_encrypt(buffer);
-            decrypted = affine_decrypt(encrypted);
+            encrypted = affine_key_encrypt(buffer, &ak, length);
+            decrypted = affine_key_decrypt(encrypted, &ak, length);
             print_full(out, buffer, encrypted, decrypted, "Affine Encrypt");
+        }else if(pipelined){
+            affine_ctx_init(&ac, &ak, !encrypting);
+            pipeline_finish(pipeline_run(fd, outfd, pipe_affine_update, pipe_affine_final, &ac));
         }else if(encrypting){
-            encrypted = affine_encrypt(buffer);
-            fprintf(out, (char*)encrypted);
+            size = affine_encrypt_par(pool, buffer, result, &ak, length);
+            output_close(outfd, result, capacity, size, mapped);
         }else{
-            decrypted = affine_decrypt(buffer);
-            fprintf(out, (char*)decrypted);
+            size = affine_decrypt_par(pool, buffer, result, &ak, length);
+            output_close(outfd, result, capacity, size, mapped);
         }
 
         break;
@@ -118,12 +270,11 @@ int main(int argc, char** argv){
             exit(0);
         }
 
-        len = strlen(buffer);
-        key = random_key_create(len);
+        key = random_key_create(length);
 
         // Only fullprint for otp
-        encrypted = otp_encrypt(buffer, key, len);
-        decrypted = otp_decrypt(encrypted, key, len);
+        encrypted = otp_encrypt(buffer, key, length);
+        decrypted = otp_decrypt(encrypted, key, length);
         print_full(out, buffer, encrypted, decrypted, "One Time Pad");
 
         break;
@@ -134,18 +285,26 @@ int main(int argc, char** argv){
             printf("error: playfair requires extra argument: keystring\n");
             exit(0);
         }
-        keys = playfair_keymatrix(argv[3]);
 
+        // full prints go through the keymatrix functions, -ENC/-DEC through a key with digram tables
         if(full){
-            encrypted = playfair_encrypt(buffer, keys);
-            decrypted = playfair_decrypt(encrypted, keys);
+            keys = playfair_keymatrix(argv[3]);
+            encrypted = playfair_encrypt(buffer, keys, length);
+            decrypted = playfair_decrypt(encrypted, keys, strlen(encrypted));
             print_full(out, buffer, encrypted, decrypted, "Playfair");
+            break;
+        }
+
+        playfair_key_init(&pk, argv[3], 1);
+        if(pipelined){
+            playfair_ctx_init(&pc, &pk, !encrypting);
+            pipeline_finish(pipeline_run(fd, outfd, pipe_playfair_update, pipe_playfair_final, &pc));
         }else if(encrypting){
-            encrypted = playfair_encrypt(buffer, keys);
-            fprintf(out, (char*)encrypted);
+            size = playfair_encrypt_par(pool, buffer, result, &pk, length);
+            output_close(outfd, result, capacity, size, mapped);
         }else{
-            decrypted = playfair_decrypt(buffer, keys);
-            fprintf(out, (char*)decrypted);
+            size = playfair_decrypt_par(pool, buffer, result, &pk, length);
+            output_close(outfd, result, capacity, size, mapped);
         }
 
         break;
@@ -157,15 +316,16 @@ int main(int argc, char** argv){
             exit(0);
         }
 
-        len = strlen(buffer);
         keys = malloc(FEISTEL_ROUNDS * sizeof(uint8_t*));
         for(z = 0; z < FEISTEL_ROUNDS; z++){
             keys[z] = malloc(4 * sizeof(uint8_t));
         }
 
         // Only fullprint for feistel
-        encrypted = feistel_encrypt(buffer, keys, len);
-        decrypted = feistel_decrypt(encrypted, keys, len);
+        encrypted = malloc(FEISTEL_PADDED_SIZE(length) + 1);
+        encrypted[feistel_encrypt_mt(buffer, encrypted, keys, length, threads)] = '\0';
+        decrypted = malloc(FEISTEL_PADDED_SIZE(length) + 1);
+        decrypted[feistel_decrypt_mt(encrypted, decrypted, keys, length, threads)] = '\0';
         print_full(out, buffer, encrypted, decrypted, "Feistel Cipher");
 
         break;
@@ -174,10 +334,429 @@ int main(int argc, char** argv){
         exit(0);
     }
 
+    crypto_arena_destroy(arena);
+    crypto_pool_destroy(pool);
+
+    // the breakdown goes to stderr so it never mixes with a result printed to stdout
+    if(stats){
+        fflush(out);
+        print_stats(stderr);
+    }
+
     //if(redirecting) fclose(out);
     return 0;
 }
 
+/*
+* sets up the affine key from the optional a b after the cipher flag, the fixed function of crypto.h when the next
+* argument is not a number. a key that is given needs both values as numbers, anything else exits with an error
+*/
+void affine_args(int argc, char **argv, affine_key *ak){
+    long a, b;
+    char *end;
+
+    a = argc > 3 ? strtol(argv[3], &end, 10) : 0;
+    if(argc < 4 || end == argv[3] || *end != '\0'){
+        affine_key_init(ak, AFFINE_MULT, AFFINE_INC);
+        return;
+    }
+
+    b = argc > 4 ? strtol(argv[4], &end, 10) : 0;
+    if(argc < 5 || end == argv[4] || *end != '\0'){
+        printf("error: affine cipher requires both key arguments: a b\n");
+        exit(0);
+    }
+    if(affine_key_init(ak, (int)(a % 26), (int)(b % 26)) != 0){
+        printf("error: affine multiplier must be coprime with 26\n");
+        exit(0);
+    }
+
+    return;
+}
+
+/*
+* -batch: sets the key up once and runs every file of argv[1] (a directory or a list of paths) through it,
+* -threads workers take whole files instead of splitting one
+*/
+int batch_main(int argc, char **argv, int encrypting){
+    int i, threads = 1, caesar;
+    char *outdir = NULL;
+    const void *key;
+    batch_fn fn;
+    batch_stats stats;
+    playfair_key pk;
+    affine_key ak;
+
+    for(i = 0; i < argc; i++){
+        if(strcmp("-outdir", argv[i]) == 0){
+            if(argc < i + 2){
+                printf("error: -outdir requires extra argument: directory name\n");
+                exit(0);
+            }
+            outdir = argv[i + 1];
+        }else if(strcmp("-threads", argv[i]) == 0){
+            if(argc < i + 2 || atoi(argv[i + 1]) < 1){
+                printf("error: -threads requires extra argument: number of threads\n");
+                exit(0);
+            }
+            threads = atoi(argv[i + 1]);
+        }
+    }
+
+    if(argv[2][0] != '-' || strlen(argv[2]) < 2){
+        printf("error: unknown cipher argument\n");
+        exit(0);
+    }
+
+    switch(argv[2][1]){
+    case 'c':
+        if(argc < 4){
+            printf("error: caesar's cipher requires extra argument: N\n");
+            exit(0);
+        }
+        caesar = atoi(argv[3]);
+        key = &caesar;
+        fn = encrypting ? batch_caesar_encrypt : batch_caesar_decrypt;
+        break;
+    case 'a':
+        affine_args(argc, argv, &ak);
+        key = &ak;
+        fn = encrypting ? batch_affine_encrypt : batch_affine_decrypt;
+        break;
+    case 'p':
+        if(argc < 4){
+            printf("error: playfair requires extra argument: keystring\n");
+            exit(0);
+        }
+        playfair_key_init(&pk, argv[3], 1);
+        key = &pk;
+        fn = encrypting ? batch_playfair_encrypt : batch_playfair_decrypt;
+        break;
+    default:
+        printf("error: -batch supports caesar, affine and playfair only\n");
+        exit(0);
+    }
+
+    if(batch_run(argv[1], outdir, encrypting ? ".enc" : ".dec", threads, fn, key, &stats) != 0){
+        printf("error: could not read batch input %s\n", argv[1]);
+        exit(0);
+    }
+    batch_report(stdout, &stats);
+
+    return 0;
+}
+
+/*
+* -crack: ranks every caesar or affine key by how english argv[1] reads under it, prints the best CRACK_SHOW with a
+* preview of their decryption to stderr and decrypts the input in whole with the best one only. playfair anneals
+* its grid against the -quadgrams model instead and reports the key it settled on
+*/
+int crack_main(int argc, char **argv){
+    keysearch_hit hits[CRACK_SHOW];
+    uint8_t preview[CRACK_PREVIEW], *input, *result;
+    struct stat in_stat;
+    int i, fd, outfd = STDOUT_FILENO, threads = 1, chains = 0, mapped;
+    size_t length, capacity, found, size, n;
+    char *quadgrams = NULL;
+    crypto_pool *pool = NULL;
+    affine_key ak;
+    quadgram_model model;
+    playfair_solve_params params;
+    playfair_solve_result solved;
+
+    for(i = 0; i < argc; i++){
+        if(strcmp("-out", argv[i]) == 0){
+            if(argc < i + 2){
+                printf("error: output redirection requires extra argument: file name\n");
+                exit(0);
+            }
+            outfd = open(argv[i + 1], O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if(outfd < 0){
+                printf("error: could not open output file for writting\n");
+                exit(0);
+            }
+        }else if(strcmp("-threads", argv[i]) == 0){
+            if(argc < i + 2 || atoi(argv[i + 1]) < 1){
+                printf("error: -threads requires extra argument: number of threads\n");
+                exit(0);
+            }
+            threads = atoi(argv[i + 1]);
+        }else if(strcmp("-quadgrams", argv[i]) == 0){
+            if(argc < i + 2){
+                printf("error: -quadgrams requires extra argument: file name\n");
+                exit(0);
+            }
+            quadgrams = argv[i + 1];
+        }else if(strcmp("-chains", argv[i]) == 0){
+            if(argc < i + 2 || atoi(argv[i + 1]) < 1){
+                printf("error: -chains requires extra argument: number of chains\n");
+                exit(0);
+            }
+            chains = atoi(argv[i + 1]);
+        }
+    }
+    if(threads > 1)
+        pool = crypto_pool_create(threads);
+
+    fd = open(argv[1], O_RDONLY);
+    if(fd < 0 || fstat(fd, &in_stat) != 0){
+        printf("error: could not open input file\n");
+        exit(0);
+    }
+    length = in_stat.st_size;
+    input = input_open(fd, length, 0);
+    if(input == NULL){
+        printf("error: could not read from file\n");
+        exit(0);
+    }
+    close(fd);
+
+    if(argv[2][0] != '-' || strlen(argv[2]) < 2 || (argv[2][1] != 'c' && argv[2][1] != 'a' && argv[2][1] != 'p')){
+        printf("error: -crack supports caesar, affine and playfair only\n");
+        exit(0);
+    }
+
+    found = 0;
+    if(argv[2][1] == 'c'){
+        found = caesar_keysearch_par(pool, input, hits, CRACK_SHOW, length);
+    }else if(argv[2][1] == 'a'){
+        found = affine_keysearch_par(pool, input, hits, CRACK_SHOW, length);
+    }else{
+        if(quadgrams == NULL){
+            printf("error: playfair -crack requires -quadgrams file: quadgram counts or english text\n");
+            exit(0);
+        }
+
+        // two whole digrams of letters, so a failing playfair_solve below can only mean it ran out of memory
+        for(n = 0, size = 0; n < length && size < 4; n++){
+            if((input[n] >= 'A' && input[n] <= 'Z') || (input[n] >= 'a' && input[n] <= 'z'))
+                size++;
+        }
+        if(size < 4){
+            printf("error: playfair -crack needs at least 4 letters of ciphertext\n");
+            exit(0);
+        }
+        if(quadgram_model_load(&model, quadgrams) != 0){
+            printf("error: could not build a quadgram model from %s\n", quadgrams);
+            exit(0);
+        }
+
+        memset(&params, 0, sizeof(params));
+        params.chains = chains ? chains : threads > CRACK_CHAINS ? threads : CRACK_CHAINS;
+        random_key_fill((uint8_t*)&params.seed, sizeof(params.seed));
+        if(playfair_solve(pool, input, &model, &params, &solved, length) != 0){
+            printf("error: could not allocate the playfair solver\n");
+            exit(0);
+        }
+        quadgram_model_free(&model);
+
+        fprintf(stderr, "================================================\n");
+        fprintf(stderr, "| key      : %.5s %.5s %.5s %.5s %.5s\n", solved.key.grid, solved.key.grid + 5,
+                solved.key.grid + 10, solved.key.grid + 15, solved.key.grid + 20);
+        fprintf(stderr, "| score    : %.4f per quadgram\n", solved.score);
+        fprintf(stderr, "| keys     : %llu in %.2f s, %.0f keys/s over %d chains\n", (unsigned long long)solved.keys,
+                solved.seconds, solved.seconds > 0 ? solved.keys / solved.seconds : 0.0, params.chains);
+    }
+
+    if(found && isinf(hits[0].score)){
+        printf("error: nothing to score, the input has no letters the %s model knows\n",
+               argv[2][1] == 'c' ? "caesar" : "affine");
+        exit(0);
+    }
+
+    // only the start of the input is decrypted for the runners up
+    n = length < CRACK_PREVIEW ? length : CRACK_PREVIEW;
+    if(found)
+        fprintf(stderr, "================================================\n");
+    for(i = 0; i < (int)found; i++){
+        if(argv[2][1] == 'c'){
+            caesar_decrypt_buf(input, preview, hits[i].key, n);
+            fprintf(stderr, "| N = %-2d        %8.4f  ", hits[i].key, hits[i].score);
+        }else{
+            affine_key_init(&ak, hits[i].key, hits[i].inc);
+            affine_decrypt_buf(input, preview, &ak, n);
+            fprintf(stderr, "| a = %-2d b = %-2d %8.4f  ", hits[i].key, hits[i].inc, hits[i].score);
+        }
+        for(size = 0; size < n; size++)
+            fputc(preview[size] >= ' ' && preview[size] < 127 ? preview[size] : ' ', stderr);
+        fputc('\n', stderr);
+    }
+    fprintf(stderr, "================================================\n");
+
+    // the best key decrypts the whole input
+    capacity = length + 1;
+    result = output_open(outfd == STDOUT_FILENO ? -1 : outfd, capacity, &mapped);
+    if(result == NULL){
+        printf("error: could not allocate output\n");
+        exit(0);
+    }
+    if(argv[2][1] == 'c'){
+        size = caesar_decrypt_par(pool, input, result, hits[0].key, length);
+    }else if(argv[2][1] == 'a'){
+        affine_key_init(&ak, hits[0].key, hits[0].inc);
+        size = affine_decrypt_par(pool, input, result, &ak, length);
+    }else{
+        size = playfair_decrypt_par(pool, input, result, &solved.key, length);
+    }
+    output_close(outfd, result, capacity, size, mapped);
+
+    crypto_pool_destroy(pool);
+
+    return 0;
+}
+
+// whole file transforms for batch_run
+size_t batch_caesar_encrypt(const void *key, uint8_t *in, uint8_t *out, size_t size){
+    return caesar_encrypt_buf(in, out, *(const int*)key, size);
+}
+
+size_t batch_caesar_decrypt(const void *key, uint8_t *in, uint8_t *out, size_t size){
+    return caesar_decrypt_buf(in, out, *(const int*)key, size);
+}
+
+size_t batch_affine_encrypt(const void *key, uint8_t *in, uint8_t *out, size_t size){
+    return affine_encrypt_buf(in, out, (const affine_key*)key, size);
+}
+
+size_t batch_affine_decrypt(const void *key, uint8_t *in, uint8_t *out, size_t size){
+    return affine_decrypt_buf(in, out, (const affine_key*)key, size);
+}
+
+size_t batch_playfair_encrypt(const void *key, uint8_t *in, uint8_t *out, size_t size){
+    return playfair_encrypt_buf(in, out, (const playfair_key*)key, size);
+}
+
+size_t batch_playfair_decrypt(const void *key, uint8_t *in, uint8_t *out, size_t size){
+    return playfair_decrypt_buf(in, out, (const playfair_key*)key, size);
+}
+
+/*
+* reports a failed pipeline run
+*/
+void pipeline_finish(long long written){
+    if(written < 0)
+        printf("error: pipelined %s I/O failed\n", pipeline_backend());
+
+    return;
+}
+
+// streaming context adapters for pipeline_run
+size_t pipe_caesar_update(void *ctx, uint8_t *in, uint8_t *out, size_t size){
+    return caesar_ctx_update((caesar_ctx*)ctx, in, out, size);
+}
+
+size_t pipe_caesar_final(void *ctx, uint8_t *out){
+    return caesar_ctx_final((caesar_ctx*)ctx, out);
+}
+
+size_t pipe_affine_update(void *ctx, uint8_t *in, uint8_t *out, size_t size){
+    return affine_ctx_update((affine_ctx*)ctx, in, out, size);
+}
+
+size_t pipe_affine_final(void *ctx, uint8_t *out){
+    return affine_ctx_final((affine_ctx*)ctx, out);
+}
+
+size_t pipe_playfair_update(void *ctx, uint8_t *in, uint8_t *out, size_t size){
+    return playfair_ctx_update((playfair_ctx*)ctx, in, out, size);
+}
+
+size_t pipe_playfair_final(void *ctx, uint8_t *out){
+    return playfair_ctx_final((playfair_ctx*)ctx, out);
+}
+
+/*
+* maps length bytes of the input file read only for a single sequential pass, or with copy reads them into a
+* null terminated buffer of length + 1 bytes (full prints and inputs about to be overwritten)
+*/
+uint8_t *input_open(int fd, size_t length, int copy){
+    uint8_t *data;
+    ssize_t got;
+    size_t done;
+
+    if(!copy && length > 0){
+        data = mmap(NULL, length, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if(data != MAP_FAILED){
+            madvise(data, length, MADV_SEQUENTIAL);
+            return data;
+        }
+    }
+
+    // not mappable (empty, a pipe) or a copy was asked for
+    data = malloc(length + 1);
+    if(data == NULL)
+        return NULL;
+
+    for(done = 0; done < length; done += got){
+        got = read(fd, data + done, length - done);
+        if(got < 0 && errno == EINTR){
+            got = 0;
+            continue;
+        }
+        if(got <= 0)
+            break;
+    }
+    data[done] = '\0';
+
+    return data;
+}
+
+/*
+* returns capacity bytes for the result: the output file itself mapped shared and grown to capacity when it is a
+* regular file, otherwise memory that output_close writes out
+*/
+uint8_t *output_open(int fd, size_t capacity, int *mapped){
+    uint8_t *data;
+
+    *mapped = 0;
+    if(fd >= 0 && ftruncate(fd, capacity) == 0){
+        data = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(data != MAP_FAILED){
+            *mapped = 1;
+            return data;
+        }
+    }
+
+    return malloc(capacity);
+}
+
+/*
+* finishes the result of size bytes: a mapped file is unmapped and cut down to size, memory is written to fd
+*/
+void output_close(int fd, uint8_t *data, size_t capacity, size_t size, int mapped){
+    if(mapped){
+        munmap(data, capacity);
+        if(ftruncate(fd, size) != 0)
+            printf("error: could not write output file\n");
+        return;
+    }
+
+    write_all(fd, data, size);
+
+    return;
+}
+
+/*
+* writes all size bytes to fd with write(), retrying short writes
+*/
+void write_all(int fd, uint8_t *data, size_t size){
+    ssize_t put;
+
+    while(size > 0){
+        put = write(fd, data, size);
+        if(put < 0 && errno == EINTR)
+            continue;
+        if(put <= 0){
+            printf("error: could not write output\n");
+            return;
+        }
+        data += put;
+        size -= put;
+    }
+
+    return;
+}
+
 void print_full(FILE *f, uint8_t *buffer, uint8_t *encrypted, uint8_t *decrypted, char *alg){
     fprintf(f, "================================================\n");
     fprintf(f, "| Encrypting using %s\n", alg);
@@ -187,4 +766,35 @@ void print_full(FILE *f, uint8_t *buffer, uint8_t *encrypted, uint8_t *decrypted
     fprintf(f, "| Encrypted: %s\n| Decrypted: %s\n", (char*)encrypted, (char*)decrypted);
     fprintf(f, "================================================\n");
     return;
-}
\ No newline at end of file
+}
+
+/*
+* prints the library counters of every cipher that was used, or a note if the library was built without them
+*/
+void print_stats(FILE *f){
+    crypto_stats stats;
+    int cipher;
+
+    if(!crypto_stats_enabled()){
+        fprintf(f, "stats: not compiled in, build with make STATS=1\n");
+        return;
+    }
+
+    fprintf(f, "================================================\n");
+    fprintf(f, "| %-9s %8s %12s %12s %7s %12s %9s %9s %9s\n", "cipher", "calls", "bytes in", "bytes out", "allocs",
+            "alloc bytes", "key ms", "prep ms", "xform ms");
+    for(cipher = 0; cipher < CRYPTO_STATS_CIPHERS; cipher++){
+        crypto_stats_get(cipher, &stats);
+        if(stats.calls == 0 && stats.allocs == 0 && stats.ns[CRYPTO_PHASE_KEY] == 0)
+            continue;
+
+        fprintf(f, "| %-9s %8llu %12llu %12llu %7llu %12llu %9.3f %9.3f %9.3f\n", crypto_stats_name(cipher),
+                (unsigned long long)stats.calls, (unsigned long long)stats.bytes_in,
+                (unsigned long long)stats.bytes_out, (unsigned long long)stats.allocs,
+                (unsigned long long)stats.alloc_bytes, stats.ns[CRYPTO_PHASE_KEY] / 1e6,
+                stats.ns[CRYPTO_PHASE_PREPROCESS] / 1e6, stats.ns[CRYPTO_PHASE_TRANSFORM] / 1e6);
+    }
+    fprintf(f, "================================================\n");
+
+    return;
+}
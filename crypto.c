@@ -6,84 +6,86 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
-#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "crypto.h"
+#include "simd.h"
+#include "pool.h"
+#include "stats.h"
+#include "arena.h"
 
 /*
-* grabs a random byte stream of given size from /dev/urandom
+* creates a random byte stream of given size from the calling thread's key generator
 */
-uint8_t *random_key_create(long size){
-    FILE *fptr;
+uint8_t *random_key_create(size_t size){
     uint8_t *data;
 
-    fptr = fopen("/dev/urandom", "r");
-    data = (uint8_t*)malloc(size * sizeof(uint8_t));
-    fread(data, sizeof(uint8_t), size, fptr);
-    fclose(fptr);
+    data = (uint8_t*)arena_get(size * sizeof(uint8_t));
+    STATS_ALLOC(CRYPTO_STATS_KEYGEN, size);
+    random_key_fill(data, size);
 
     return data;
 }
 
 /*
-* encrypts given plaintext using caesar's cipher and key N
+* fills the given buffer with size random bytes from the calling thread's key generator, without allocating
 */
-uint8_t *caesar_encrypt(uint8_t *plaintext, uint16_t N){
-    uint8_t c, *ciphertext;
-    int i, size;
+void random_key_fill(uint8_t *data, size_t size){
+    STATS_START(t);
 
-    size = strlen(plaintext);
-    ciphertext = (uint8_t*)malloc((size + 1) * sizeof(uint8_t));
+    drbg_generate(drbg_default(), data, size);
+    STATS_PHASE(CRYPTO_STATS_KEYGEN, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_KEYGEN, 0, size);
 
-    for(i = 0; i < size; i++){
-        c = plaintext[i];
+    return;
+}
 
-        // get decimal char representation
-        if(c >= 'a' && c <= 'z'){
-            c = c - 'a' + 36;
-        }else
-        if(c >= 'A' && c <= 'Z'){
-            c = c - 'A' + 10;
-        }else
-        if(c >= '0' && c <= '9'){
-            c = c - '0';
-        }else{
-            ciphertext[i] = c;
-            continue;
-        }
+// last caesar key tables built on this thread, rebuilt only when the key changes
+static __thread subst_table caesar_cache;
+static __thread int caesar_cache_key = -1;
 
-        // add key
-        c = MOD((c + N), 62);
-        
-        // bring back to char representation
-        if(c <= 9){
-            c += '0';
-        }else
-        if(c <= 35){
-            c = 'A' + (c - 10);
-        }else{
-            c = 'a' + (c - 36);
-        }
+// affine key of the fixed linear function defined in crypto.h, built once per process
+static affine_key affine_default;
+static pthread_once_t affine_default_once = PTHREAD_ONCE_INIT;
 
-        ciphertext[i] = c;
+// pools of the *_mt feistel functions by thread count, made on first use and kept so no call spawns threads
+static crypto_pool *feistel_mt_pools[FEISTEL_MAX_THREADS + 1];
+static pthread_mutex_t feistel_mt_lock = PTHREAD_MUTEX_INITIALIZER;
 
-    }
-    ciphertext[i] = '\0';
+/*
+* fills the inverse half of a substitution table from its forward half
+*/
+static void subst_invert(subst_table *table){
+    int c;
 
-    return ciphertext;
+    for(c = 0; c < 256; c++)
+        table->dec[table->enc[c]] = c;
+
+    return;
 }
 
 /*
-* decrypts given ciphertext using caesar's cipher and key N
+* transforms size bytes of in into out (may be in itself) through one of the halves of a substitution table,
+* returns the number of bytes written
 */
-uint8_t *caesar_decrypt(uint8_t *ciphertext, uint16_t N){
-    uint8_t c, *plaintext;
-    int i, size;
+size_t subst_apply(const uint8_t *table, uint8_t *in, uint8_t *out, size_t size){
+    size_t i;
 
-    size = strlen(ciphertext);
-    plaintext = (uint8_t*)malloc((size + 1) * sizeof(uint8_t));
+    for(i = 0; i < size; i++)
+        out[i] = table[in[i]];
 
-    for(i = 0; i < size; i++){
-        c = ciphertext[i];
+    return size;
+}
+
+/*
+* builds the caesar tables for key N, 0-9A-Za-z shift around the 62 symbol alphabet and everything else maps to itself
+*/
+void caesar_table_init(subst_table *table, uint16_t N){
+    uint8_t c;
+    int i;
+
+    for(i = 0; i < 256; i++){
+        c = i;
 
         // get decimal char representation
         if(c >= 'a' && c <= 'z'){
@@ -95,12 +97,12 @@ uint8_t *caesar_decrypt(uint8_t *ciphertext, uint16_t N){
         if(c >= '0' && c <= '9'){
             c = c - '0';
         }else{
-            plaintext[i] = c;
+            table->enc[i] = c;
             continue;
         }
 
-        // subtract key
-        c = MOD((c - N), 62);
+        // add key
+        c = MOD((c + N), 62);
         
         // bring back to char representation
         if(c <= 9){
@@ -112,578 +114,2211 @@ uint8_t *caesar_decrypt(uint8_t *ciphertext, uint16_t N){
             c = 'a' + (c - 36);
         }
 
-        plaintext[i] = c;
-
+        table->enc[i] = c;
     }
-    plaintext[i] = '\0';
 
-    return plaintext;
+    // subtracting the key is the inverse permutation
+    subst_invert(table);
+
+    return;
 }
 
 /*
-* encrypts given plaintext using affine cipher using the linear function defined in cs457_crypto.h
+* builds the affine tables for mult * x + inc, only A-Z is substituted
 */
-uint8_t *affine_encrypt(uint8_t *plaintext){
-    uint8_t *ciphertext;
-    int i, eq, x, size;
+static void affine_table_fill(subst_table *table, int mult, int inc){
+    int i, eq, x;
 
-    size = strlen(plaintext);
-    ciphertext = (uint8_t*)malloc((size + 1) * sizeof(uint8_t));
-
-    for(i = 0; i < size; i++){
+    for(i = 0; i < 256; i++){
 
         // if symbol not in used alphabet
-        if(plaintext[i] < 'A' || plaintext[i] > 'Z'){
-            ciphertext[i] = plaintext[i];
+        if(i < 'A' || i > 'Z'){
+            table->enc[i] = i;
             continue;
         }
 
         // numeric equivalent of character (only uppercase ASCII)
-        x = plaintext[i] - 'A';
+        x = i - 'A';
 
         // calculate affine equivalent (a*x + b) % m
-        eq = AFFINE_MULT * x + AFFINE_INC;
-        ciphertext[i] = 'A' + MOD(eq, 26);
+        eq = mult * x + inc;
+        table->enc[i] = 'A' + MOD(eq, 26);
     }
-    ciphertext[i] = '\0';
 
-    return ciphertext;
+    // the inverse table replaces searching for the multiplicative inverse
+    subst_invert(table);
+
+    return;
 }
 
 /*
-* decrypts given plaintext using affine cipher using the linear function defined in cs457_crypto.h
+* builds the affine tables for the linear function defined in crypto.h, only A-Z is substituted
 */
-uint8_t *affine_decrypt(uint8_t *ciphertext){
-    uint8_t *plaintext;
-    int i, x, size, inv, eq;
+void affine_table_init(subst_table *table){
+    affine_table_fill(table, AFFINE_MULT, AFFINE_INC);
 
-    size = strlen(ciphertext);
-    plaintext = (uint8_t*)malloc((size + 1) * sizeof(uint8_t));
+    return;
+}
 
-    // find multiplicative inverse to inverse linear function used to encrypt
-    for(i = 0; i < 26; i++){
-        if((AFFINE_MULT * i) % 26 ==  1)
-            inv = i;
-    }
+/*
+* multiplicative inverse of a modulo 26 with the extended euclidean algorithm, -1 if gcd(a, 26) is not 1
+*/
+static int affine_inverse(int a){
+    int r0, r1, t0, t1, q, tmp;
 
-    for(i = 0; i < size; i++){
+    r0 = 26;
+    r1 = MOD(a, 26);
+    t0 = 0;
+    t1 = 1;
 
-        // if symbol not in used alphabet
-        // this will not cause any problems as the result on encryption
-        // is modulo 26
-        if(ciphertext[i] < 'A' || ciphertext[i] > 'Z'){
-            plaintext[i] = ciphertext[i];
-            continue;
-        }
+    while(r1 != 0){
+        q = r0 / r1;
 
-        // numeric equivalent of character (only uppercase ASCII)
-        x = ciphertext[i] - 'A';
+        tmp = r0 - q * r1;
+        r0 = r1;
+        r1 = tmp;
 
-        // reverse encrypt function
-        eq = inv * (x - AFFINE_INC);
-        plaintext[i] = 'A' + MOD(eq, 26);
+        tmp = t0 - q * t1;
+        t0 = t1;
+        t1 = tmp;
     }
-    plaintext[i] = '\0';
 
-    return plaintext;
+    // r0 is the gcd, t0 the coefficient of a
+    if(r0 != 1)
+        return -1;
+
+    return MOD(t0, 26);
 }
 
 /*
-* preprocesses the plaintext for one time pad to use, removing all characters not in our desired alphabet
+* sets up an affine key for a * x + b, computing the inverse function and both tables once.
+* returns 0, or -1 leaving the key untouched if a has no inverse (gcd(a, 26) != 1)
 */
-static uint8_t *otp_preprocess(uint8_t *plaintext){
-    uint8_t *processed;
-    int size, i, j;
+int affine_key_init(affine_key *key, int a, int b){
+    int inverse;
+    STATS_START(t);
 
-    size = strlen(plaintext);
+    inverse = affine_inverse(a);
+    if(inverse < 0)
+        return -1;
 
-    processed = (uint8_t*)malloc((size + 1) * sizeof(uint8_t));
+    key->mult = MOD(a, 26);
+    key->inc = MOD(b, 26);
 
-    for(i = 0, j = 0; i < size + 1; i++){
+    // x = inv * (y - b) = inv * y - inv * b
+    key->dec_mult = inverse;
+    key->dec_inc = MOD(-inverse * key->inc, 26);
 
-        // if character is in used alphabet 0-9a-zA-Z, add to processed
-        if((plaintext[i] >= '0' && plaintext[i] <= '9') || (plaintext[i] >= 'a' && plaintext[i] <= 'z') || (plaintext[i] >= 'A' && plaintext[i] <= 'Z') || plaintext[i] == ' '){
-            processed[j++] = plaintext[i];
-        }
-    }
+    affine_table_fill(&key->table, key->mult, key->inc);
+    STATS_PHASE(CRYPTO_STATS_AFFINE, CRYPTO_PHASE_KEY, t);
 
-    for(i = j; i < size + 1; i++)
-        processed[i] = '\0';
+    return 0;
+}
+
+/*
+* returns this thread's cached caesar tables for key N
+*/
+static const subst_table *caesar_table(uint16_t N){
+    if(caesar_cache_key != N){
+        caesar_table_init(&caesar_cache, N);
+        caesar_cache_key = N;
+    }
 
-    return processed;
+    return &caesar_cache;
 }
 
 /*
-* encrypts given plaintext using one time pad, xoring every byte of the plaintext with every byte of the key
+* pthread_once body building the key of the fixed linear function
 */
-uint8_t *otp_encrypt(uint8_t *plaintext, uint8_t* key, uint16_t length){
-    uint8_t *ciphertext, *processed;
-    int i, size;
+static void affine_default_init(void){
+    affine_key_init(&affine_default, AFFINE_MULT, AFFINE_INC);
 
-    processed = otp_preprocess(plaintext);
+    return;
+}
 
-    size = length;
+/*
+* returns the affine key of the fixed linear function
+*/
+static const affine_key *affine_default_key(void){
+    pthread_once(&affine_default_once, affine_default_init);
 
-    ciphertext = (uint8_t *)malloc((size + 1) * sizeof(uint8_t));
+    return &affine_default;
+}
 
-    for(i = 0; i < size; i++){
+/*
+* shifts size bytes of in by key N into out (may be in itself), forwards or backwards
+*/
+static size_t caesar_transform(uint8_t *in, uint8_t *out, size_t size, uint16_t N, int decrypt){
+    const simd_kernels *simd = simd_get();
 
-        // xor every char with every byte of key
-        ciphertext[i] = processed[i] ^ key[i];
+    // subtracting the key is adding its complement
+    if(simd->caesar){
+        simd->caesar(in, out, size, decrypt ? (62 - N % 62) % 62 : N % 62);
+        return size;
     }
-    ciphertext[i] = '\0';
 
-    return ciphertext;
+    return subst_apply(decrypt ? caesar_table(N)->dec : caesar_table(N)->enc, in, out, size);
 }
 
 /*
-* decrypts given ciphertext using one time pad, xoring every byte of the ciphertext with every byte of the key
+* encrypts length bytes of plaintext using caesar's cipher and key N into out, which must hold length bytes
+* (out may be the plaintext itself), returns the number of bytes written
 */
-uint8_t *otp_decrypt(uint8_t *ciphertext, uint8_t* key, uint16_t length){
-    uint8_t *plaintext;
-    int i, size;
+size_t caesar_encrypt_buf(uint8_t *plaintext, uint8_t *out, uint16_t N, size_t length){
+    STATS_START(t);
 
-    size = length;
+    caesar_transform(plaintext, out, length, N, 0);
+    STATS_PHASE(CRYPTO_STATS_CAESAR, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_CAESAR, length, length);
 
-    plaintext = (uint8_t *)malloc((size + 1) * sizeof(uint8_t));
+    return length;
+}
 
-    for(i = 0; i < length; i++){
+/*
+* encrypts given plaintext using caesar's cipher and key N
+*/
+uint8_t *caesar_encrypt(uint8_t *plaintext, uint16_t N, size_t length){
+    uint8_t *ciphertext;
+    size_t size;
 
-        // xor ciphertext with key bytes to inverse encryption
-        plaintext[i] = ciphertext[i] ^ key[i];
-    }
-    plaintext[i] = '\0';
+    ciphertext = (uint8_t*)arena_get((length + 1) * sizeof(uint8_t));
+    STATS_ALLOC(CRYPTO_STATS_CAESAR, length + 1);
+    size = caesar_encrypt_buf(plaintext, ciphertext, N, length);
+    ciphertext[size] = '\0';
 
-    return plaintext;
+    return ciphertext;
 }
 
 /*
-* preprocesses the plaintext for feistel to use, creating extra blocks and adding padding if needed
+* decrypts length bytes of ciphertext using caesar's cipher and key N into out, which must hold length bytes
+* (out may be the ciphertext itself), returns the number of bytes written
 */
-static uint8_t *preprocess_plaintext(uint8_t *plaintext){
-    uint8_t *processed;
-    int size, new_size, blocks, i;
-
-    size = strlen(plaintext);
-
-    // round up size according to feistel block size
-    if(size % FEISTEL_BLOCK_SIZE != 0)
-        blocks = (size / FEISTEL_BLOCK_SIZE) + 1;
-    else
-        blocks = size / FEISTEL_BLOCK_SIZE;
+size_t caesar_decrypt_buf(uint8_t *ciphertext, uint8_t *out, uint16_t N, size_t length){
+    STATS_START(t);
 
-    new_size = blocks * FEISTEL_BLOCK_SIZE;
+    caesar_transform(ciphertext, out, length, N, 1);
+    STATS_PHASE(CRYPTO_STATS_CAESAR, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_CAESAR, length, length);
 
-    processed = (uint8_t*)malloc((new_size + 1) * sizeof(uint8_t));
+    return length;
+}
 
-    // copy initial text
-    for(i = 0; i < size; i++){
-        processed[i] = plaintext[i];
-    }
+/*
+* decrypts given ciphertext using caesar's cipher and key N
+*/
+uint8_t *caesar_decrypt(uint8_t *ciphertext, uint16_t N, size_t length){
+    uint8_t *plaintext;
+    size_t size;
 
-    // fill with null padding
-    for(i = size; i < new_size; i++){
-        processed[i] = '\0';
-    }
-    processed[i] = '\0';
+    plaintext = (uint8_t*)arena_get((length + 1) * sizeof(uint8_t));
+    STATS_ALLOC(CRYPTO_STATS_CAESAR, length + 1);
+    size = caesar_decrypt_buf(ciphertext, plaintext, N, length);
+    plaintext[size] = '\0';
 
-    return processed;
+    return plaintext;
 }
 
 /*
-* flips (literally) the first and last 4 bytes of given address
+* starts streaming caesar's cipher with key N, encrypting or decrypting
 */
-static void feistel_flip(uint8_t *block){
-    uint8_t temp[FEISTEL_BLOCK_SIZE / 2];
-    int i;
-
-    // save left side and replace with right
-    for(i = 0; i < FEISTEL_BLOCK_SIZE / 2; i++){
-        temp[i] = block[i];
-        block[i] = block[FEISTEL_BLOCK_SIZE / 2 + i];
-    }
-
-    // replace right side with temp
-    for(i = 0; i < FEISTEL_BLOCK_SIZE / 2; i++)
-        block[FEISTEL_BLOCK_SIZE / 2 + i] = temp[i];
+void caesar_ctx_init(caesar_ctx *ctx, uint16_t N, int decrypt){
+    ctx->N = N;
+    ctx->decrypt = decrypt;
 
     return;
 }
 
 /*
-* the feistel round function as defined in the assignment
+* transforms the next size bytes into out, which must hold size bytes (may be in itself), returns the bytes written
 */
-static uint8_t *feistel_round(uint8_t *block, uint8_t *key){
-    uint8_t *rounded, c;
-    int i;
-
-    rounded = (uint8_t*)malloc((FEISTEL_BLOCK_SIZE / 2) * sizeof(uint8_t));
+size_t caesar_ctx_update(caesar_ctx *ctx, uint8_t *in, uint8_t *out, size_t size){
+    STATS_START(t);
 
-    // get modulo of xored with key 32 bit block mod 2^32
-    for(i = 0; i < FEISTEL_BLOCK_SIZE / 2; i++){
-        c = block[i] * key[i];
-        rounded[i] = MOD(c, (int)pow(2, 8));
-    }
+    caesar_transform(in, out, size, ctx->N, ctx->decrypt);
+    STATS_PHASE(CRYPTO_STATS_CAESAR, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_CAESAR, size, size);
 
-    return rounded;
+    return size;
 }
 
 /*
-* encrypt the given plaintext with the feistel algorithm, running for FEISTEL_ROUNDS rounds (defined in cs457_crypto.h) and creating a random key each round,
-* storing it in the corresponding row of keys matrix
+* ends the stream, caesar keeps nothing across chunks so nothing is written. a no-op kept so every cipher streams
+* through the same init/update/final calls
 */
-uint8_t *feistel_encrypt(uint8_t *plaintext, uint8_t **keys, uint16_t length){
-    uint8_t *ciphertext, *processed, *rounded, *rand;
-    int i, j, blocks, size, round;
-
-    size = length;
+size_t caesar_ctx_final(caesar_ctx *ctx, uint8_t *out){
+    (void)ctx;
+    (void)out;
 
-    ciphertext = (uint8_t*)malloc(size * sizeof(uint8_t));
+    return 0;
+}
 
-    // get preprocessed text with padding
-    processed = preprocess_plaintext(plaintext);
+/*
+* runs size bytes of in through the key's affine function or its inverse into out (may be in itself)
+*/
+static size_t affine_transform(const affine_key *key, uint8_t *in, uint8_t *out, size_t size, int decrypt){
+    const simd_kernels *simd = simd_get();
+
+    if(simd->affine){
+        if(decrypt)
+            simd->affine(in, out, size, key->dec_mult, key->dec_inc);
+        else
+            simd->affine(in, out, size, key->mult, key->inc);
+        return size;
+    }
 
-    // round up size with padding
-    if(size % FEISTEL_BLOCK_SIZE != 0)
-        blocks = (size / FEISTEL_BLOCK_SIZE) + 1;
-    else
-        blocks = size / FEISTEL_BLOCK_SIZE;
+    return subst_apply(decrypt ? key->table.dec : key->table.enc, in, out, size);
+}
 
-    size = blocks * FEISTEL_BLOCK_SIZE;
+/*
+* encrypts length bytes of plaintext using affine cipher and given key into out, which must hold length bytes
+* (out may be the plaintext itself), returns the number of bytes written
+*/
+size_t affine_encrypt_buf(uint8_t *plaintext, uint8_t *out, const affine_key *key, size_t length){
+    STATS_START(t);
 
-    for(round = 0; round < FEISTEL_ROUNDS; round++){
+    affine_transform(key, plaintext, out, length, 0);
+    STATS_PHASE(CRYPTO_STATS_AFFINE, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_AFFINE, length, length);
 
-        // create a new key and store it to corresponding row
-        rand = random_key_create(4);
-        memcpy(&keys[round][0], rand, 4);
+    return length;
+}
 
-        for(i = 0; i < blocks; i++){
-            // get rounded
-            rounded = feistel_round(processed + (i * FEISTEL_BLOCK_SIZE) + (FEISTEL_BLOCK_SIZE / 2), rand);
+/*
+* encrypts given plaintext using affine cipher using the linear function defined in cs457_crypto.h
+*/
+uint8_t *affine_encrypt(uint8_t *plaintext, size_t length){
+    return affine_key_encrypt(plaintext, affine_default_key(), length);
+}
 
-            // XOR with left
-            for(j = 0; j < FEISTEL_BLOCK_SIZE / 2; j++){
-                processed[j + (i * FEISTEL_BLOCK_SIZE)] = processed[j + (i * FEISTEL_BLOCK_SIZE)] ^ rounded[j];
-            }
+/*
+* encrypts given plaintext using affine cipher and given key, returns a null terminated malloc'ed copy
+*/
+uint8_t *affine_key_encrypt(uint8_t *plaintext, const affine_key *key, size_t length){
+    uint8_t *ciphertext;
+    size_t size;
 
-            // literally flip (could be implemented so much better)
-            feistel_flip(processed + (i * FEISTEL_BLOCK_SIZE));
-        }
-    }
+    ciphertext = (uint8_t*)arena_get((length + 1) * sizeof(uint8_t));
+    STATS_ALLOC(CRYPTO_STATS_AFFINE, length + 1);
+    size = affine_encrypt_buf(plaintext, ciphertext, key, length);
+    ciphertext[size] = '\0';
 
-    return processed;
+    return ciphertext;
 }
 
 /*
-* decrypts ciphertext using feistel and using the keys the encrypt function created
+* decrypts length bytes of ciphertext using affine cipher and given key into out, which must hold length bytes
+* (out may be the ciphertext itself), returns the number of bytes written
 */
-uint8_t *feistel_decrypt(uint8_t *ciphertext, uint8_t **keys, uint16_t length){
-    uint8_t *plaintext, *processed, *rounded, *rand;
-    int i, j, blocks, size, round;
+size_t affine_decrypt_buf(uint8_t *ciphertext, uint8_t *out, const affine_key *key, size_t length){
+    STATS_START(t);
 
-    rand = (uint8_t*)malloc(4 * sizeof(uint8_t));
-    size = length;
+    affine_transform(key, ciphertext, out, length, 1);
+    STATS_PHASE(CRYPTO_STATS_AFFINE, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_AFFINE, length, length);
 
-    // round up size
-    if(size % FEISTEL_BLOCK_SIZE != 0)
-        blocks = (size / FEISTEL_BLOCK_SIZE) + 1;
-    else
-        blocks = size / FEISTEL_BLOCK_SIZE;
-
-    size = blocks * FEISTEL_BLOCK_SIZE;
+    return length;
+}
 
-    // heap corruption on playfair so i leave it like this? (use after free????)
-    processed = (uint8_t*)malloc((size + 1) * sizeof(uint8_t));
-    memcpy(processed, ciphertext, size + 1);
+/*
+* decrypts given plaintext using affine cipher using the linear function defined in cs457_crypto.h
+*/
+uint8_t *affine_decrypt(uint8_t *ciphertext, size_t length){
+    return affine_key_decrypt(ciphertext, affine_default_key(), length);
+}
 
-    for(round = 0; round < FEISTEL_ROUNDS; round++){
+/*
+* decrypts given ciphertext using affine cipher and given key, returns a null terminated malloc'ed copy
+*/
+uint8_t *affine_key_decrypt(uint8_t *ciphertext, const affine_key *key, size_t length){
+    uint8_t *plaintext;
+    size_t size;
 
-        // get key from key matrix for current round (set by encrypt)
-        memcpy(rand, &keys[FEISTEL_ROUNDS - 1 - round][0], 4);
+    plaintext = (uint8_t*)arena_get((length + 1) * sizeof(uint8_t));
+    STATS_ALLOC(CRYPTO_STATS_AFFINE, length + 1);
+    size = affine_decrypt_buf(ciphertext, plaintext, key, length);
+    plaintext[size] = '\0';
 
-        for(i = 0; i < blocks; i++){
-            // flip on start of round
-            feistel_flip(processed + (i * FEISTEL_BLOCK_SIZE));
+    return plaintext;
+}
 
-            // get rounded
-            rounded = feistel_round(processed + (i * FEISTEL_BLOCK_SIZE) + (FEISTEL_BLOCK_SIZE / 2), rand);
+/*
+* starts streaming the affine cipher with given key, encrypting or decrypting
+*/
+void affine_ctx_init(affine_ctx *ctx, const affine_key *key, int decrypt){
+    ctx->key = key;
+    ctx->decrypt = decrypt;
 
-            //printf("String: %p -> %p\n", processed, processed + (i * FEISTEL_BLOCK_SIZE) + (FEISTEL_BLOCK_SIZE / 2));
+    return;
+}
 
-            // XOR with left
-            for(j = 0; j < FEISTEL_BLOCK_SIZE / 2; j++){
-                processed[j + (i * FEISTEL_BLOCK_SIZE)] = processed[j + (i * FEISTEL_BLOCK_SIZE)] ^ rounded[j];
-            }
+/*
+* transforms the next size bytes into out, which must hold size bytes (may be in itself), returns the bytes written
+*/
+size_t affine_ctx_update(affine_ctx *ctx, uint8_t *in, uint8_t *out, size_t size){
+    STATS_START(t);
 
-            
-        }
-    }
+    affine_transform(ctx->key, in, out, size, ctx->decrypt);
+    STATS_PHASE(CRYPTO_STATS_AFFINE, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_AFFINE, size, size);
 
-    return processed;
+    return size;
 }
 
 /*
-* structs the keymatrix made from key by filling the rest of the alphabet and replacing Is with Js
+* ends the stream, affine keeps nothing across chunks so nothing is written. a no-op kept so every cipher streams
+* through the same init/update/final calls
 */
-uint8_t **playfair_keymatrix(uint8_t *key){
-    uint8_t **keymatrix, alphabet[26] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z'};
-    int used[26], i, j, k, filled;
+size_t affine_ctx_final(affine_ctx *ctx, uint8_t *out){
+    (void)ctx;
+    (void)out;
 
-    // calloc didnt work ok
-    for(i = 0; i < 26; i++)
-        used[i] = 0;
-        
-    // 2d array
-    keymatrix = (uint8_t**)malloc(5 * sizeof(uint8_t*));
+    return 0;
+}
 
-    for(i = 0; i < 5; i++)
-        keymatrix[i] = (uint8_t*)malloc(5 * sizeof(uint8_t));
+/*
+* removes all characters not in the one time pad alphabet from size bytes of in, writing the kept ones into out
+* (may be in itself), returns how many were kept. the simd filter builds a keep mask and compacts a whole vector at
+* once instead of branching on every byte
+*/
+static size_t otp_filter(uint8_t *in, uint8_t *out, size_t size){
+    const simd_kernels *simd = simd_get();
+    size_t i, j;
 
-    // fill initial key
-    i = 0;
-    j = 0;
-    filled = 0;
-    for(k = 0; k < strlen(key); k++){      
-        // check if already used
-        if(!used[key[k] - 'A'] && (key[k] >= 'A' && key[k] <= 'Z')){
-            keymatrix[i][j] = key[k];
-            j++;
-
-            // switch row
-            if(j % 5 == 0){
-                i++;
-                j = 0;
-            }
+    if(simd->otp_filter)
+        return simd->otp_filter(in, out, size);
 
-            // set used
-            used[key[k] - 'A'] = 1;
-            filled++;
-        }
+    for(i = 0, j = 0; i < size; i++){
+        if((in[i] >= '0' && in[i] <= '9') || (in[i] >= 'a' && in[i] <= 'z') || (in[i] >= 'A' && in[i] <= 'Z') || in[i] == ' ')
+            out[j++] = in[i];
     }
 
-    // fill rest of the alphabet
-    k = 0;
-    while(filled < 25){
-        // check if used
-        if(!used[k] && alphabet[k] != 'I'){
-            keymatrix[i][j] = alphabet[k];
-
-            j++;
+    return j;
+}
 
-            if(j % 5 == 0){
-                i++;
-                j = 0;
-            }
+/*
+* preprocesses the plaintext for one time pad to use, removing all characters not in our desired alphabet
+* and null padding the result back up to size bytes into processed (may be the plaintext itself)
+*/
+static void otp_preprocess(uint8_t *plaintext, uint8_t *processed, size_t size){
+    size_t kept;
 
-            used[k] = 1;
-            filled++;
-        }
-        k++;
-    }
+    kept = otp_filter(plaintext, processed, size);
+    memset(processed + kept, 0, size - kept);
 
-    return keymatrix;
+    return;
 }
 
 /*
-* matches the given 2 characters on the keymatrix in an encryption fashion (positive) and returns the encrypted ones
+* encrypts length bytes of plaintext using one time pad into out, which must hold length bytes
+* (out may be the plaintext itself), returns the number of bytes written
 */
-static uint8_t *playfair_encrypt_match(uint8_t **keymatrix, uint8_t *text){
-    uint8_t *encoded;
-    int i, j, i1, i2, j1, j2;
+size_t otp_encrypt_buf(uint8_t *plaintext, uint8_t *out, uint8_t* key, size_t length){
+    STATS_START(t);
 
-    encoded = (uint8_t*)malloc(2 * sizeof(uint8_t));
-    
-    // find in matrix
-    for(i = 0; i < 5; i++){ 
-        for(j = 0; j < 5; j++){
-            if(keymatrix[i][j] == text[0]){
-                i1 = i;
-                j1 = j;
-            }else if(keymatrix[i][j] == text[1]){
-                i2 = i;
-                j2 = j;
-            }
-        }
-    }
+    otp_preprocess(plaintext, out, length);
+    STATS_PHASE(CRYPTO_STATS_OTP, CRYPTO_PHASE_PREPROCESS, t);
 
-    if(i1 == i2){ // same row
-        encoded[0] = keymatrix[i1][(j1 + 1) % 5];
-        encoded[1] = keymatrix[i2][(j2 + 1) % 5];
-    }else if(j1 == j2){ // same column
-        encoded[0] = keymatrix[(i1 + 1) % 5][j1];
-        encoded[1] = keymatrix[(i2 + 1) % 5][j2];
-    }else{ // square
-        encoded[0] = keymatrix[i1][j2];
-        encoded[1] = keymatrix[i2][j1];
-    }
+    // xor every char with every byte of key
+    simd_get()->xor(out, key, out, length);
+    STATS_PHASE(CRYPTO_STATS_OTP, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_OTP, length, length);
 
-    return encoded;
+    return length;
 }
 
 /*
-* matches the given 2 characters on the keymatrix in a decryption fashion (negative) and returns the decrypted ones
+* encrypts given plaintext using one time pad, xoring every byte of the plaintext with every byte of the key
 */
-static uint8_t *playfair_decrypt_match(uint8_t **keymatrix, uint8_t *text){
-    uint8_t *encoded;
-    int i, j, i1, i2, j1, j2;
-
-    encoded = (uint8_t*)malloc(2 * sizeof(uint8_t));
-
-    // find in matrix
-    for(i = 0; i < 5; i++){ 
-        for(j = 0; j < 5; j++){
-            if(keymatrix[i][j] == text[0]){
-                i1 = i;
-                j1 = j;
-            }else if(keymatrix[i][j] == text[1]){
-                i2 = i;
-                j2 = j;
-            }
-        }
-    }
+uint8_t *otp_encrypt(uint8_t *plaintext, uint8_t* key, size_t length){
+    uint8_t *ciphertext;
 
-    if(i1 == i2){ // same row
-        encoded[0] = keymatrix[i1][MOD((j1 - 1), 5)];
-        encoded[1] = keymatrix[i2][MOD((j2 - 1), 5)];
-    }else if(j1 == j2){ // same column
-        encoded[0] = keymatrix[MOD((i1 - 1), 5)][j1];
-        encoded[1] = keymatrix[MOD((i2 - 1), 5)][j2];
-    }else{ // square
-        encoded[0] = keymatrix[i1][j2];
-        encoded[1] = keymatrix[i2][j1];
-    }
+    ciphertext = (uint8_t*)arena_get((length + 1) * sizeof(uint8_t));
+    STATS_ALLOC(CRYPTO_STATS_OTP, length + 1);
+    otp_encrypt_buf(plaintext, ciphertext, key, length);
+    ciphertext[length] = '\0';
 
-    return encoded;
+    return ciphertext;
 }
 
 /*
-* preprocesses the plaintext for playfair to use, setting an X at the end if the text was odd lengthed or setting X on double char appearances
-* and removing special characters not in the alphabet
+* decrypts length bytes of ciphertext using one time pad into out, which must hold length bytes
+* (out may be the ciphertext itself), returns the number of bytes written
 */
-static uint8_t *playfair_preprocess(uint8_t *text){
-    uint8_t *processed, *no_specials;
-    int i, j, size, wasOdd, blocks, specials = 0;
+size_t otp_decrypt_buf(uint8_t *ciphertext, uint8_t *out, uint8_t* key, size_t length){
+    STATS_START(t);
 
-    size = strlen(text);
+    // xor ciphertext with key bytes to inverse encryption
+    simd_get()->xor(ciphertext, key, out, length);
+    STATS_PHASE(CRYPTO_STATS_OTP, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_OTP, length, length);
 
-    // count special chars
-    for(i = 0; i < size; i++){
-        if(text[i] < 'A' || text[i] > 'Z'){
-            specials++;
-        }
-    }
-
-    // allocate for actual chars
-    no_specials = (uint8_t*)malloc((size - specials + 1) * sizeof(uint8_t));
-
-    // struct no_specials
-    for(i = 0, j = 0; i < size; i++){
+    return length;
+}
 
-        // if in alphabet
-        if(text[i] >= 'A' && text[i] <= 'Z'){
+/*
+* decrypts given ciphertext using one time pad, xoring every byte of the ciphertext with every byte of the key
+*/
+uint8_t *otp_decrypt(uint8_t *ciphertext, uint8_t* key, size_t length){
+    uint8_t *plaintext;
 
-            // switch Is to Js
-            if(text[i] != 'I')
-                no_specials[j++] = text[i];
-            else
-                no_specials[j++] = 'J';
-        }
-    }
-    no_specials[j] = '\0';
-    size = size - specials; // new size
+    plaintext = (uint8_t*)arena_get((length + 1) * sizeof(uint8_t));
+    STATS_ALLOC(CRYPTO_STATS_OTP, length + 1);
+    otp_decrypt_buf(ciphertext, plaintext, key, length);
+    plaintext[length] = '\0';
 
-    // if odd, add up extra space
-    wasOdd = 0;
-    if(size % 2 != 0){
-        size++;
-        wasOdd = 1;
-    }
+    return plaintext;
+}
 
-    blocks = size / 2;
+/*
+* starts streaming the one time pad with given key, which must be at least as long as the whole stream
+*/
+void otp_ctx_init(otp_ctx *ctx, uint8_t *key, int decrypt){
+    ctx->key = key;
+    ctx->offset = 0;
+    ctx->decrypt = decrypt;
 
-    // final processed
-    processed = (uint8_t*)malloc((size + 1) * sizeof(uint8_t));
+    return;
+}
 
-    // for every 2 byte block
-    for(i = 0; i < blocks; i++){
+/*
+* transforms the next size bytes into out, which must hold size bytes (may be in itself), returns the bytes written.
+* encryption drops characters outside the alphabet like otp_encrypt but does not pad the ciphertext for them
+*/
+size_t otp_ctx_update(otp_ctx *ctx, uint8_t *in, uint8_t *out, size_t size){
+    size_t kept;
+    STATS_START(t);
 
-        // first char will always be what it is
-        processed[i * 2] = no_specials[i * 2];
+    kept = size;
+    if(!ctx->decrypt)
+        kept = otp_filter(in, out, size);
+    else
+        memmove(out, in, size);
+    STATS_PHASE(CRYPTO_STATS_OTP, CRYPTO_PHASE_PREPROCESS, t);
 
-        // check if second should be X
-        if(wasOdd && i == (blocks - 1)){ // if odd
-            processed[(i * 2) + 1] = 'X';
-        }else if(no_specials[i * 2] == no_specials[(i * 2) + 1]){ // if 2 same chars
-            processed[(i * 2) + 1] = 'X';
-        }else{ // if normal
-            processed[(i * 2) + 1] = no_specials[(i * 2) + 1];
-        }
-    }
-    processed[i * 2] = '\0';
+    simd_get()->xor(out, ctx->key + ctx->offset, out, kept);
+    ctx->offset += kept;
+    STATS_PHASE(CRYPTO_STATS_OTP, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_OTP, size, kept);
 
-    return processed;
+    return kept;
 }
 
 /*
-* encrypts given plaintext using given keymatrix
+* ends the stream, the key offset is all that is kept so nothing is written. a no-op kept so every cipher streams
+* through the same init/update/final calls
 */
-uint8_t *playfair_encrypt(uint8_t *plaintext, uint8_t **key){
-    uint8_t *ciphertext, *processed, *encrypted, *text;
-    int i, size, blocks;
+size_t otp_ctx_final(otp_ctx *ctx, uint8_t *out){
+    (void)ctx;
+    (void)out;
 
-    // preprocess adding Xs and removing special chars
-    processed = playfair_preprocess(plaintext);
+    return 0;
+}
 
-    size = strlen(processed);
-    blocks = size / 2;
-    text = (uint8_t*)malloc(2 * sizeof(uint8_t));
-    ciphertext = (uint8_t*)malloc((size + 1) * sizeof(uint8_t));
+/*
+* preprocesses the plaintext for feistel to use, copying it into processed (may be the plaintext itself)
+* and null padding up to the next block, returns the padded size
+*/
+static size_t preprocess_plaintext(uint8_t *plaintext, uint8_t *processed, size_t size){
+    size_t new_size, i;
 
-    // for every 2 byte block
-    for(i = 0; i < blocks; i++){
-        // get plaintext
-        text[0] = processed[i * 2];
-        text[1] = processed[(i * 2) + 1];
+    new_size = FEISTEL_PADDED_SIZE(size);
 
-        // encrypt on matrix
-        encrypted = playfair_encrypt_match(key, text);
+    // copy initial text
+    if(processed != plaintext)
+        memmove(processed, plaintext, size);
 
-        // set encrypted
-        ciphertext[i * 2] = encrypted[0];
-        ciphertext[(i * 2) + 1] = encrypted[1];
+    // fill with null padding
+    for(i = size; i < new_size; i++){
+        processed[i] = '\0';
+    }
+
+    return new_size;
+}
+
+#if FEISTEL_BLOCK_SIZE != 8
+#error "the feistel kernels work on 8 byte blocks split in two 32 bit halves"
+#endif
+
+// byte lanes of a feistel half and of two whole blocks, multiplied lane by lane mod 2^8
+typedef uint8_t feistel_half_lanes __attribute__((vector_size(4)));
+typedef uint8_t feistel_pair_lanes __attribute__((vector_size(16)));
+typedef uint32_t feistel_pair_words __attribute__((vector_size(16)));
+
+/*
+* flips (literally) the left and right 32 bit halves of a block, only swapping the registers they live in
+*/
+static inline void feistel_flip(uint32_t *left, uint32_t *right){
+    uint32_t temp;
+
+    temp = *left;
+    *left = *right;
+    *right = temp;
+
+    return;
+}
+
+/*
+* the feistel round function as defined in the assignment, every byte of the half times the matching key byte mod 2^8
+*/
+static inline uint32_t feistel_round(uint32_t half, uint32_t key){
+    feistel_half_lanes h, k;
+
+    memcpy(&h, &half, sizeof(h));
+    memcpy(&k, &key, sizeof(k));
+    h = h * k;
+    memcpy(&half, &h, sizeof(h));
+
+    return half;
+}
+
+/*
+* loads the per round key rows into a schedule of 32 bit words with the same lane order as the block halves
+*/
+static void feistel_schedule(uint8_t **keys, uint32_t *schedule){
+    int round;
+
+    for(round = 0; round < FEISTEL_ROUNDS; round++)
+        memcpy(&schedule[round], keys[round], sizeof(uint32_t));
+
+    return;
+}
+
+/*
+* runs all encryption rounds on a single block kept in two 32 bit halves, rounds are unrolled in pairs so the
+* halves swap roles instead of being flipped
+*/
+static inline void feistel_block_encrypt(uint8_t *block, const uint32_t *schedule){
+    uint32_t left, right;
+    int round;
+
+    memcpy(&left, block, sizeof(left));
+    memcpy(&right, block + FEISTEL_BLOCK_SIZE / 2, sizeof(right));
+
+    for(round = 0; round + 1 < FEISTEL_ROUNDS; round += 2){
+        left ^= feistel_round(right, schedule[round]);
+        right ^= feistel_round(left, schedule[round + 1]);
+    }
+
+    // odd round count ends on a real flip
+    if(round < FEISTEL_ROUNDS){
+        left ^= feistel_round(right, schedule[round]);
+        feistel_flip(&left, &right);
+    }
+
+    memcpy(block, &left, sizeof(left));
+    memcpy(block + FEISTEL_BLOCK_SIZE / 2, &right, sizeof(right));
+
+    return;
+}
+
+/*
+* runs all decryption rounds on a single block, the mirror of feistel_block_encrypt with the schedule reversed
+*/
+static inline void feistel_block_decrypt(uint8_t *block, const uint32_t *schedule){
+    uint32_t left, right;
+    int round;
+
+    memcpy(&left, block, sizeof(left));
+    memcpy(&right, block + FEISTEL_BLOCK_SIZE / 2, sizeof(right));
+
+    for(round = 0; round + 1 < FEISTEL_ROUNDS; round += 2){
+        right ^= feistel_round(left, schedule[FEISTEL_ROUNDS - 1 - round]);
+        left ^= feistel_round(right, schedule[FEISTEL_ROUNDS - 2 - round]);
+    }
+
+    if(round < FEISTEL_ROUNDS){
+        right ^= feistel_round(left, schedule[FEISTEL_ROUNDS - 1 - round]);
+        feistel_flip(&left, &right);
+    }
+
+    memcpy(block, &left, sizeof(left));
+    memcpy(block + FEISTEL_BLOCK_SIZE / 2, &right, sizeof(right));
+
+    return;
+}
+
+/*
+* runs all encryption rounds on two adjacent blocks at once, a round is (L, R) -> (R, L ^ f(R)) which is the
+* halves swapped xored with the block times a key that is zero over the left lanes
+*/
+static inline void feistel_pair_encrypt(uint8_t *blocks, const feistel_pair_lanes *schedule){
+    const feistel_pair_words swap = {1, 0, 3, 2};
+    feistel_pair_lanes v;
+    int round;
+
+    memcpy(&v, blocks, sizeof(v));
+
+    for(round = 0; round < FEISTEL_ROUNDS; round++)
+        v = (feistel_pair_lanes)__builtin_shuffle((feistel_pair_words)v, swap) ^ (v * schedule[round]);
+
+    memcpy(blocks, &v, sizeof(v));
+
+    return;
+}
+
+/*
+* runs all decryption rounds on two adjacent blocks at once, (L, R) -> (R ^ f(L), L) with the key over the left lanes
+*/
+static inline void feistel_pair_decrypt(uint8_t *blocks, const feistel_pair_lanes *schedule){
+    const feistel_pair_words swap = {1, 0, 3, 2};
+    feistel_pair_lanes v;
+    int round;
+
+    memcpy(&v, blocks, sizeof(v));
+
+    for(round = 0; round < FEISTEL_ROUNDS; round++)
+        v = (feistel_pair_lanes)__builtin_shuffle((feistel_pair_words)v, swap) ^ (v * schedule[FEISTEL_ROUNDS - 1 - round]);
+
+    memcpy(blocks, &v, sizeof(v));
+
+    return;
+}
+
+/*
+* spreads the 32 bit schedule over two blocks, with the key on the right lanes (encrypt) or the left lanes (decrypt)
+*/
+static void feistel_pair_schedule(const uint32_t *schedule, feistel_pair_lanes *pair, int decrypt){
+    feistel_pair_words w;
+    int round;
+
+    for(round = 0; round < FEISTEL_ROUNDS; round++){
+        if(decrypt){
+            w = (feistel_pair_words){schedule[round], 0, schedule[round], 0};
+        }else{
+            w = (feistel_pair_words){0, schedule[round], 0, schedule[round]};
+        }
+        pair[round] = (feistel_pair_lanes)w;
+    }
+
+    return;
+}
+
+/*
+* runs every block of a padded buffer through all the rounds, each block staying in registers until it is done
+*/
+static void feistel_blocks(uint8_t *data, size_t blocks, const uint32_t *schedule, int decrypt){
+    feistel_pair_lanes pair[FEISTEL_ROUNDS];
+    size_t i;
+
+    feistel_pair_schedule(schedule, pair, decrypt);
+
+    for(i = 0; i + 1 < blocks; i += 2){
+        if(decrypt)
+            feistel_pair_decrypt(data + (i * FEISTEL_BLOCK_SIZE), pair);
+        else
+            feistel_pair_encrypt(data + (i * FEISTEL_BLOCK_SIZE), pair);
+    }
+
+    // odd block out
+    if(i < blocks){
+        if(decrypt)
+            feistel_block_decrypt(data + (i * FEISTEL_BLOCK_SIZE), schedule);
+        else
+            feistel_block_encrypt(data + (i * FEISTEL_BLOCK_SIZE), schedule);
+    }
+
+    return;
+}
+
+/*
+* encrypts length bytes of plaintext with feistel into out, which must hold FEISTEL_PADDED_SIZE(length) bytes
+* (out may be the plaintext itself), storing the round keys in keys, returns the number of bytes written
+*/
+size_t feistel_encrypt_buf(uint8_t *plaintext, uint8_t *out, uint8_t **keys, size_t length){
+    uint32_t schedule[FEISTEL_ROUNDS];
+    size_t size;
+    int round;
+    STATS_START(t);
+
+    // get preprocessed text with padding
+    size = preprocess_plaintext(plaintext, out, length);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_PREPROCESS, t);
+
+    // create a new key for every round and store it to corresponding row
+    for(round = 0; round < FEISTEL_ROUNDS; round++)
+        random_key_fill(keys[round], FEISTEL_BLOCK_SIZE / 2);
+    feistel_schedule(keys, schedule);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_KEY, t);
+
+    feistel_blocks(out, size / FEISTEL_BLOCK_SIZE, schedule, 0);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_FEISTEL, length, size);
+
+    return size;
+}
+
+/*
+* encrypt the given plaintext with the feistel algorithm, running for FEISTEL_ROUNDS rounds (defined in cs457_crypto.h) and creating a random key each round,
+* storing it in the corresponding row of keys matrix
+*/
+uint8_t *feistel_encrypt(uint8_t *plaintext, uint8_t **keys, size_t length){
+    uint8_t *ciphertext;
+    size_t size;
+
+    ciphertext = (uint8_t*)arena_get((FEISTEL_PADDED_SIZE(length) + 1) * sizeof(uint8_t));
+    STATS_ALLOC(CRYPTO_STATS_FEISTEL, FEISTEL_PADDED_SIZE(length) + 1);
+    size = feistel_encrypt_buf(plaintext, ciphertext, keys, length);
+    ciphertext[size] = '\0';
+
+    return ciphertext;
+}
+
+/*
+* decrypts length bytes of ciphertext with feistel into out, which must hold FEISTEL_PADDED_SIZE(length) bytes
+* (out may be the ciphertext itself), using the keys the encrypt function created, returns the number of bytes written
+*/
+size_t feistel_decrypt_buf(uint8_t *ciphertext, uint8_t *out, uint8_t **keys, size_t length){
+    uint32_t schedule[FEISTEL_ROUNDS];
+    size_t size;
+    STATS_START(t);
+
+    // round up size
+    size = FEISTEL_PADDED_SIZE(length);
+
+    if(out != ciphertext)
+        memmove(out, ciphertext, size);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_PREPROCESS, t);
+
+    // get keys from key matrix (set by encrypt)
+    feistel_schedule(keys, schedule);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_KEY, t);
+
+    feistel_blocks(out, size / FEISTEL_BLOCK_SIZE, schedule, 1);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_FEISTEL, length, size);
+
+    return size;
+}
+
+/*
+* decrypts ciphertext using feistel and using the keys the encrypt function created
+*/
+uint8_t *feistel_decrypt(uint8_t *ciphertext, uint8_t **keys, size_t length){
+    uint8_t *plaintext;
+    size_t size;
+
+    plaintext = (uint8_t*)arena_get((FEISTEL_PADDED_SIZE(length) + 1) * sizeof(uint8_t));
+    STATS_ALLOC(CRYPTO_STATS_FEISTEL, FEISTEL_PADDED_SIZE(length) + 1);
+    size = feistel_decrypt_buf(ciphertext, plaintext, keys, length);
+    plaintext[size] = '\0';
+
+    return plaintext;
+}
+
+/*
+* starts streaming feistel, encryption creates a random key per round and stores it in keys like feistel_encrypt,
+* decryption uses the keys encryption created
+*/
+void feistel_ctx_init(feistel_ctx *ctx, uint8_t **keys, int decrypt){
+    int round;
+    STATS_START(t);
+
+    if(!decrypt){
+        for(round = 0; round < FEISTEL_ROUNDS; round++)
+            random_key_fill(keys[round], FEISTEL_BLOCK_SIZE / 2);
+    }
+    feistel_schedule(keys, ctx->schedule);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_KEY, t);
+
+    ctx->filled = 0;
+    ctx->decrypt = decrypt;
+
+    return;
+}
+
+/*
+* transforms the whole blocks available after adding size bytes into out, which must hold size + FEISTEL_BLOCK_SIZE
+* bytes and not overlap in, keeps the partial block for the next call and returns the bytes written
+*/
+size_t feistel_ctx_update(feistel_ctx *ctx, uint8_t *in, uint8_t *out, size_t size){
+    size_t n, whole, written;
+    STATS_START(t);
+
+    written = 0;
+    n = 0;
+
+    // complete the block left over from the last chunk
+    if(ctx->filled > 0){
+        n = FEISTEL_BLOCK_SIZE - ctx->filled;
+        if(n > size)
+            n = size;
+
+        memcpy(ctx->partial + ctx->filled, in, n);
+        ctx->filled += n;
+        in += n;
+        size -= n;
+
+        if(ctx->filled < FEISTEL_BLOCK_SIZE){
+            STATS_CALL(CRYPTO_STATS_FEISTEL, n, 0);
+            return 0;
+        }
+
+        feistel_blocks(ctx->partial, 1, ctx->schedule, ctx->decrypt);
+        memcpy(out, ctx->partial, FEISTEL_BLOCK_SIZE);
+        written = FEISTEL_BLOCK_SIZE;
+        ctx->filled = 0;
+    }
+
+    whole = (size / FEISTEL_BLOCK_SIZE) * FEISTEL_BLOCK_SIZE;
+    memcpy(out + written, in, whole);
+    feistel_blocks(out + written, whole / FEISTEL_BLOCK_SIZE, ctx->schedule, ctx->decrypt);
+    written += whole;
+
+    // keep the tail
+    memcpy(ctx->partial, in + whole, size - whole);
+    ctx->filled = size - whole;
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_FEISTEL, n + size, written);
+
+    return written;
+}
+
+/*
+* ends the stream, null padding and transforming the partial block if there is one into out (FEISTEL_BLOCK_SIZE bytes),
+* returns the bytes written
+*/
+size_t feistel_ctx_final(feistel_ctx *ctx, uint8_t *out){
+    STATS_START(t);
+
+    if(ctx->filled == 0)
+        return 0;
+
+    memset(ctx->partial + ctx->filled, 0, FEISTEL_BLOCK_SIZE - ctx->filled);
+    feistel_blocks(ctx->partial, 1, ctx->schedule, ctx->decrypt);
+    memcpy(out, ctx->partial, FEISTEL_BLOCK_SIZE);
+    ctx->filled = 0;
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+
+    // the input was counted by the update that buffered it
+    STATS_CALL(CRYPTO_STATS_FEISTEL, 0, FEISTEL_BLOCK_SIZE);
+
+    return FEISTEL_BLOCK_SIZE;
+}
+
+/*
+* whether length bytes at byte offset stay inside the block indices a nonce has, past them the counters would wrap
+*/
+static int feistel_ctr_fits(uint64_t offset, size_t length){
+    return offset <= FEISTEL_CTR_MAX_LENGTH && length <= FEISTEL_CTR_MAX_LENGTH - offset;
+}
+
+/*
+* xors size bytes of in that start at byte offset of the counter mode stream with its keystream into out (may be in
+* itself). the keystream is made FEISTEL_CTR_BATCH blocks at a time: the counters, nonce in the high 32 bits and block
+* index in the low ones, are laid out in a stack buffer and encrypted by feistel_blocks like any plaintext, so no block depends on the one before
+*/
+static void feistel_ctr_xor(const uint8_t *in, uint8_t *out, const uint32_t *schedule, uint32_t nonce, uint64_t offset,
+                            size_t size){
+    uint8_t stream[FEISTEL_CTR_BATCH * FEISTEL_BLOCK_SIZE];
+    uint64_t block, counter;
+    size_t skip, blocks, n, i;
+
+    block = offset / FEISTEL_BLOCK_SIZE;
+    skip = offset % FEISTEL_BLOCK_SIZE;
+
+    while(size > 0){
+        blocks = (skip + size + FEISTEL_BLOCK_SIZE - 1) / FEISTEL_BLOCK_SIZE;
+        if(blocks > FEISTEL_CTR_BATCH)
+            blocks = FEISTEL_CTR_BATCH;
+
+        for(i = 0; i < blocks; i++){
+            counter = ((uint64_t)nonce << 32) | (block + i);
+            memcpy(stream + (i * FEISTEL_BLOCK_SIZE), &counter, FEISTEL_BLOCK_SIZE);
+        }
+        feistel_blocks(stream, blocks, schedule, 0);
+
+        // the first batch may start inside its first block
+        n = blocks * FEISTEL_BLOCK_SIZE - skip;
+        if(n > size)
+            n = size;
+        simd_get()->xor(in, stream + skip, out, n);
+
+        in += n;
+        out += n;
+        size -= n;
+        block += blocks;
+        skip = 0;
+    }
+
+    return;
+}
+
+/*
+* encrypts length bytes of plaintext with feistel in counter mode into out, which must hold length bytes (out may be
+* the plaintext itself), using the round keys in keys and a nonce never used with them before. returns length, or 0
+* leaving out untouched if length is over FEISTEL_CTR_MAX_LENGTH
+*/
+size_t feistel_ctr_encrypt_buf(uint8_t *plaintext, uint8_t *out, uint8_t **keys, uint32_t nonce, size_t length){
+    return feistel_ctr_crypt_at(plaintext, out, keys, nonce, 0, length);
+}
+
+/*
+* decrypts length bytes of ciphertext made by feistel_ctr_encrypt_buf with the same keys and nonce into out, which
+* must hold length bytes (out may be the ciphertext itself). returns length, or 0 if it is over FEISTEL_CTR_MAX_LENGTH
+*/
+size_t feistel_ctr_decrypt_buf(uint8_t *ciphertext, uint8_t *out, uint8_t **keys, uint32_t nonce, size_t length){
+    return feistel_ctr_crypt_at(ciphertext, out, keys, nonce, 0, length);
+}
+
+/*
+* encrypts or decrypts (the same in counter mode) length bytes of in that sit at byte offset of the whole stream into
+* out, which must hold length bytes (out may be in itself). only the blocks covering the range are generated, so a
+* record in the middle of a large file decrypts without touching the rest. returns length, or 0 leaving out untouched
+* if the range runs past FEISTEL_CTR_MAX_LENGTH
+*/
+size_t feistel_ctr_crypt_at(uint8_t *in, uint8_t *out, uint8_t **keys, uint32_t nonce, uint64_t offset, size_t length){
+    uint32_t schedule[FEISTEL_ROUNDS];
+    STATS_START(t);
+
+    if(!feistel_ctr_fits(offset, length))
+        return 0;
+
+    feistel_schedule(keys, schedule);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_KEY, t);
+
+    feistel_ctr_xor(in, out, schedule, nonce, offset, length);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_FEISTEL, length, length);
+
+    return length;
+}
+
+// a 16 byte block (or half of a 32 byte one) as byte lanes and as the 64 bit words its halves are swapped by
+typedef uint8_t feistel_wide_lanes __attribute__((vector_size(16)));
+typedef uint64_t feistel_wide_words __attribute__((vector_size(16)));
+
+/*
+* 8 byte blocks two at a time like feistel_pair_encrypt, with the round count and the key lanes taken from the
+* params. lanes holds one 32 byte row per round of which the first 16 bytes are used
+*/
+static inline __attribute__((always_inline)) void feistel_run8(uint8_t *data, size_t blocks, const uint8_t *lanes,
+                                                               int rounds){
+    const feistel_pair_words swap = {1, 0, 3, 2};
+    feistel_pair_lanes v, w, k;
+    uint8_t last[16];
+    size_t i;
+    int round;
+
+    for(i = 0; i + 3 < blocks; i += 4){
+        memcpy(&v, data + (i * 8), sizeof(v));
+        memcpy(&w, data + (i * 8) + 16, sizeof(w));
+        for(round = 0; round < rounds; round++){
+            memcpy(&k, lanes + (round * FEISTEL_MAX_BLOCK), sizeof(k));
+            v = (feistel_pair_lanes)__builtin_shuffle((feistel_pair_words)v, swap) ^ (v * k);
+            w = (feistel_pair_lanes)__builtin_shuffle((feistel_pair_words)w, swap) ^ (w * k);
+        }
+        memcpy(data + (i * 8), &v, sizeof(v));
+        memcpy(data + (i * 8) + 16, &w, sizeof(w));
+    }
+
+    // up to 3 blocks left, run through a zero padded pair at a time
+    for(; i < blocks; i += 2){
+        memset(last, 0, sizeof(last));
+        memcpy(last, data + (i * 8), blocks - i >= 2 ? 16 : 8);
+        memcpy(&v, last, sizeof(v));
+        for(round = 0; round < rounds; round++){
+            memcpy(&k, lanes + (round * FEISTEL_MAX_BLOCK), sizeof(k));
+            v = (feistel_pair_lanes)__builtin_shuffle((feistel_pair_words)v, swap) ^ (v * k);
+        }
+        memcpy(last, &v, sizeof(v));
+        memcpy(data + (i * 8), last, blocks - i >= 2 ? 16 : 8);
+    }
+
+    return;
+}
+
+/*
+* 16 byte blocks, each one a vector whose 64 bit halves swap every round, two blocks in flight
+*/
+static inline __attribute__((always_inline)) void feistel_run16(uint8_t *data, size_t blocks, const uint8_t *lanes,
+                                                                int rounds){
+    const feistel_wide_words swap = {1, 0};
+    feistel_wide_lanes v, w, k;
+    size_t i;
+    int round;
+
+    for(i = 0; i + 1 < blocks; i += 2){
+        memcpy(&v, data + (i * 16), sizeof(v));
+        memcpy(&w, data + (i * 16) + 16, sizeof(w));
+        for(round = 0; round < rounds; round++){
+            memcpy(&k, lanes + (round * FEISTEL_MAX_BLOCK), sizeof(k));
+            v = (feistel_wide_lanes)__builtin_shuffle((feistel_wide_words)v, swap) ^ (v * k);
+            w = (feistel_wide_lanes)__builtin_shuffle((feistel_wide_words)w, swap) ^ (w * k);
+        }
+        memcpy(data + (i * 16), &v, sizeof(v));
+        memcpy(data + (i * 16) + 16, &w, sizeof(w));
+    }
+
+    if(i < blocks){
+        memcpy(&v, data + (i * 16), sizeof(v));
+        for(round = 0; round < rounds; round++){
+            memcpy(&k, lanes + (round * FEISTEL_MAX_BLOCK), sizeof(k));
+            v = (feistel_wide_lanes)__builtin_shuffle((feistel_wide_words)v, swap) ^ (v * k);
+        }
+        memcpy(data + (i * 16), &v, sizeof(v));
+    }
+
+    return;
+}
+
+/*
+* 32 byte blocks, their halves held in two 16 byte vectors so a round renames them instead of swapping lanes. the key
+* multiplies the right half to encrypt and the left one to decrypt, two blocks in flight
+*/
+static inline __attribute__((always_inline)) void feistel_run32(uint8_t *data, size_t blocks, const uint8_t *lanes,
+                                                                int rounds, int decrypt){
+    feistel_wide_lanes l, r, m, n, k, t;
+    size_t i, b;
+    int round;
+
+    for(i = 0; i < blocks; i += b){
+        b = blocks - i >= 2 ? 2 : 1;
+        memcpy(&l, data + (i * 32), sizeof(l));
+        memcpy(&r, data + (i * 32) + 16, sizeof(r));
+        memcpy(&m, data + ((i + b - 1) * 32), sizeof(m));
+        memcpy(&n, data + ((i + b - 1) * 32) + 16, sizeof(n));
+        for(round = 0; round < rounds; round++){
+            if(decrypt){
+                memcpy(&k, lanes + (round * FEISTEL_MAX_BLOCK), sizeof(k));
+                t = r ^ (l * k);
+                r = l;
+                l = t;
+                t = n ^ (m * k);
+                n = m;
+                m = t;
+            }else{
+                memcpy(&k, lanes + (round * FEISTEL_MAX_BLOCK) + 16, sizeof(k));
+                t = l ^ (r * k);
+                l = r;
+                r = t;
+                t = m ^ (n * k);
+                m = n;
+                n = t;
+            }
+        }
+        // a lone last block ran twice, storing the second copy last leaves it the same
+        memcpy(data + (i * 32), &l, sizeof(l));
+        memcpy(data + (i * 32) + 16, &r, sizeof(r));
+        memcpy(data + ((i + b - 1) * 32), &m, sizeof(m));
+        memcpy(data + ((i + b - 1) * 32) + 16, &n, sizeof(n));
+    }
+
+    return;
+}
+
+/*
+* runs every block of a padded buffer through the params' rounds on the kernel of its block size, the default round
+* count gets a copy of each kernel with the rounds fully unrolled
+*/
+static void feistel_params_blocks(const feistel_params *params, uint8_t *data, size_t blocks, int decrypt){
+    const uint8_t *lanes = params->lanes[decrypt ? 1 : 0][0];
+
+    switch(params->block_size){
+    case 8:
+        if(params->rounds == FEISTEL_ROUNDS)
+            feistel_run8(data, blocks, lanes, FEISTEL_ROUNDS);
+        else
+            feistel_run8(data, blocks, lanes, params->rounds);
+        break;
+    case 16:
+        if(params->rounds == FEISTEL_ROUNDS)
+            feistel_run16(data, blocks, lanes, FEISTEL_ROUNDS);
+        else
+            feistel_run16(data, blocks, lanes, params->rounds);
+        break;
+    default:
+        if(decrypt && params->rounds == FEISTEL_ROUNDS)
+            feistel_run32(data, blocks, lanes, FEISTEL_ROUNDS, 1);
+        else if(decrypt)
+            feistel_run32(data, blocks, lanes, params->rounds, 1);
+        else if(params->rounds == FEISTEL_ROUNDS)
+            feistel_run32(data, blocks, lanes, FEISTEL_ROUNDS, 0);
+        else
+            feistel_run32(data, blocks, lanes, params->rounds, 0);
+        break;
+    }
+
+    return;
+}
+
+/*
+* spreads the round keys over the kernel lanes: encryption multiplies the right half of every block, decryption
+* the left half with the rounds in reverse. 8 byte blocks run in pairs so their keys repeat over 16 bytes
+*/
+static void feistel_params_lanes(feistel_params *params){
+    size_t half = params->block_size / 2, width;
+    const uint8_t *key;
+    int round, b;
+
+    width = params->block_size == 8 ? 16 : params->block_size;
+    memset(params->lanes, 0, sizeof(params->lanes));
+
+    for(round = 0; round < params->rounds; round++){
+        for(b = 0; b < (int)width; b += params->block_size){
+            key = params->keys + (round * half);
+            memcpy(&params->lanes[0][round][b + half], key, half);
+            key = params->keys + ((params->rounds - 1 - round) * half);
+            memcpy(&params->lanes[1][round][b], key, half);
+        }
+    }
+
+    return;
+}
+
+/*
+* sets up feistel for block_size (8, 16 or 32) byte blocks and 1 to FEISTEL_MAX_ROUNDS rounds with fresh random round
+* keys. returns 0, or -1 leaving params untouched if the block size or round count is not supported
+*/
+int feistel_params_init(feistel_params *params, int block_size, int rounds){
+    STATS_START(t);
+
+    if((block_size != 8 && block_size != 16 && block_size != 32) || rounds < 1 || rounds > FEISTEL_MAX_ROUNDS)
+        return -1;
+
+    params->block_size = block_size;
+    params->rounds = rounds;
+    random_key_fill(params->keys, (size_t)rounds * (block_size / 2));
+    feistel_params_lanes(params);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_KEY, t);
+
+    return 0;
+}
+
+/*
+* replaces the round keys of params with rounds * block_size / 2 bytes of keys, round after round (e.g. the keys of
+* an earlier feistel_params_init to decrypt with)
+*/
+void feistel_params_set_keys(feistel_params *params, const uint8_t *keys){
+    STATS_START(t);
+
+    memcpy(params->keys, keys, (size_t)params->rounds * (params->block_size / 2));
+    feistel_params_lanes(params);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_KEY, t);
+
+    return;
+}
+
+/*
+* encrypts length bytes of plaintext with the feistel of params into out, which must hold
+* FEISTEL_PARAMS_PADDED_SIZE(params, length) bytes (out may be the plaintext itself), returns the bytes written
+*/
+size_t feistel_params_encrypt_buf(uint8_t *plaintext, uint8_t *out, const feistel_params *params, size_t length){
+    size_t size;
+    STATS_START(t);
+
+    size = FEISTEL_PARAMS_PADDED_SIZE(params, length);
+    if(out != plaintext)
+        memmove(out, plaintext, length);
+    memset(out + length, 0, size - length);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_PREPROCESS, t);
+
+    feistel_params_blocks(params, out, size / params->block_size, 0);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_FEISTEL, length, size);
+
+    return size;
+}
+
+/*
+* decrypts length bytes of ciphertext with the feistel of params into out, which must hold
+* FEISTEL_PARAMS_PADDED_SIZE(params, length) bytes (out may be the ciphertext itself), returns the bytes written
+*/
+size_t feistel_params_decrypt_buf(uint8_t *ciphertext, uint8_t *out, const feistel_params *params, size_t length){
+    size_t size;
+    STATS_START(t);
+
+    size = FEISTEL_PARAMS_PADDED_SIZE(params, length);
+    if(out != ciphertext)
+        memmove(out, ciphertext, size);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_PREPROCESS, t);
+
+    feistel_params_blocks(params, out, size / params->block_size, 1);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_FEISTEL, length, size);
+
+    return size;
+}
+
+// one *_par call, every chunk transforms its own slice of in into the same place of out
+struct par_job {
+    uint8_t *in;
+    uint8_t *out;
+    const uint8_t *key;
+    const uint32_t *schedule;
+    const playfair_key *pk;
+    const affine_key *ak;
+    const feistel_params *fp;
+    size_t *counts;     // playfair letters per chunk, turned into each chunk's first output letter
+    uint8_t *lasts;     // last playfair letter of each chunk (0 for none), turned into the one pending before it
+    size_t letters;     // playfair letters of the whole input
+    size_t size;
+    size_t chunk;       // bytes per chunk, the whole input when it stays on the calling thread
+    uint32_t nonce;     // feistel counter mode nonce, the offset of the whole input in the stream in offset
+    uint64_t offset;
+    uint16_t N;
+    int decrypt;
+};
+
+/*
+* finds the slice of chunk, returns its offset and stores its length in size
+*/
+static inline size_t par_slice(const struct par_job *job, size_t chunk, size_t *size){
+    size_t offset;
+
+    offset = chunk * job->chunk;
+    *size = (job->size - offset < job->chunk) ? job->size - offset : job->chunk;
+
+    return offset;
+}
+
+static void par_caesar_chunk(void *arg, size_t chunk){
+    struct par_job *job = (struct par_job*)arg;
+    size_t offset, size;
+
+    offset = par_slice(job, chunk, &size);
+    caesar_transform(job->in + offset, job->out + offset, size, job->N, job->decrypt);
+
+    return;
+}
+
+static void par_affine_chunk(void *arg, size_t chunk){
+    struct par_job *job = (struct par_job*)arg;
+    size_t offset, size;
+
+    offset = par_slice(job, chunk, &size);
+    affine_transform(job->ak, job->in + offset, job->out + offset, size, job->decrypt);
+
+    return;
+}
+
+static void par_xor_chunk(void *arg, size_t chunk){
+    struct par_job *job = (struct par_job*)arg;
+    size_t offset, size;
+
+    offset = par_slice(job, chunk, &size);
+    simd_get()->xor(job->in + offset, job->key + offset, job->out + offset, size);
+
+    return;
+}
+
+// feistel chunks are whole blocks already in out, CRYPTO_PAR_CHUNK being a multiple of the block
+static void par_feistel_chunk(void *arg, size_t chunk){
+    struct par_job *job = (struct par_job*)arg;
+    size_t offset, size;
+
+    offset = par_slice(job, chunk, &size);
+    feistel_blocks(job->out + offset, size / FEISTEL_BLOCK_SIZE, job->schedule, job->decrypt);
+
+    return;
+}
+
+// feistel_params chunks are whole blocks already in out, every supported block size divides CRYPTO_PAR_CHUNK
+static void par_feistel_params_chunk(void *arg, size_t chunk){
+    struct par_job *job = (struct par_job*)arg;
+    size_t offset, size;
+
+    offset = par_slice(job, chunk, &size);
+    feistel_params_blocks(job->fp, job->out + offset, size / job->fp->block_size, job->decrypt);
+
+    return;
+}
+
+// counter mode chunks start at their own block, no chunk needs the keystream of another
+static void par_feistel_ctr_chunk(void *arg, size_t chunk){
+    struct par_job *job = (struct par_job*)arg;
+    size_t offset, size;
+
+    offset = par_slice(job, chunk, &size);
+    feistel_ctr_xor(job->in + offset, job->out + offset, job->schedule, job->nonce, job->offset + offset, size);
+
+    return;
+}
+
+/*
+* runs a job across the pool in CRYPTO_PAR_CHUNK slices, or in one go on the calling thread if there is no pool,
+* a single thread or less input than the pool's threshold
+*/
+static void par_run(crypto_pool *pool, struct par_job *job, pool_chunk_fn fn){
+    if(job->size == 0)
+        return;
+
+    if(pool == NULL || job->size < crypto_pool_threshold(pool) || crypto_pool_threads(pool) <= 1){
+        job->chunk = job->size;
+        fn(job, 0);
+        return;
+    }
+
+    job->chunk = CRYPTO_PAR_CHUNK;
+    pool_run(pool, (job->size + CRYPTO_PAR_CHUNK - 1) / CRYPTO_PAR_CHUNK, fn, job);
+
+    return;
+}
+
+/*
+* same as caesar_encrypt_buf but splits the input across the pool, the output is identical
+*/
+size_t caesar_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, uint16_t N, size_t length){
+    struct par_job job = {.in = plaintext, .out = out, .size = length, .N = N, .decrypt = 0};
+    STATS_START(t);
+
+    par_run(pool, &job, par_caesar_chunk);
+    STATS_PHASE(CRYPTO_STATS_CAESAR, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_CAESAR, length, length);
+
+    return length;
+}
+
+/*
+* same as caesar_decrypt_buf but splits the input across the pool, the output is identical
+*/
+size_t caesar_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, uint16_t N, size_t length){
+    struct par_job job = {.in = ciphertext, .out = out, .size = length, .N = N, .decrypt = 1};
+    STATS_START(t);
+
+    par_run(pool, &job, par_caesar_chunk);
+    STATS_PHASE(CRYPTO_STATS_CAESAR, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_CAESAR, length, length);
+
+    return length;
+}
+
+/*
+* same as affine_encrypt_buf but splits the input across the pool, the output is identical
+*/
+size_t affine_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, const affine_key *key, size_t length){
+    struct par_job job = {.in = plaintext, .out = out, .ak = key, .size = length, .decrypt = 0};
+    STATS_START(t);
+
+    par_run(pool, &job, par_affine_chunk);
+    STATS_PHASE(CRYPTO_STATS_AFFINE, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_AFFINE, length, length);
+
+    return length;
+}
+
+/*
+* same as affine_decrypt_buf but splits the input across the pool, the output is identical
+*/
+size_t affine_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, const affine_key *key, size_t length){
+    struct par_job job = {.in = ciphertext, .out = out, .ak = key, .size = length, .decrypt = 1};
+    STATS_START(t);
+
+    par_run(pool, &job, par_affine_chunk);
+    STATS_PHASE(CRYPTO_STATS_AFFINE, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_AFFINE, length, length);
+
+    return length;
+}
+
+/*
+* same as otp_encrypt_buf but splits the xor across the pool, the output is identical.
+* filtering moves characters between chunks so it stays a single pass on the calling thread
+*/
+size_t otp_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, uint8_t *key, size_t length){
+    struct par_job job = {.in = out, .out = out, .key = key, .size = length};
+    STATS_START(t);
+
+    otp_preprocess(plaintext, out, length);
+    STATS_PHASE(CRYPTO_STATS_OTP, CRYPTO_PHASE_PREPROCESS, t);
+    par_run(pool, &job, par_xor_chunk);
+    STATS_PHASE(CRYPTO_STATS_OTP, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_OTP, length, length);
+
+    return length;
+}
+
+/*
+* same as otp_decrypt_buf but splits the xor across the pool, the output is identical
+*/
+size_t otp_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, uint8_t *key, size_t length){
+    struct par_job job = {.in = ciphertext, .out = out, .key = key, .size = length};
+    STATS_START(t);
+
+    par_run(pool, &job, par_xor_chunk);
+    STATS_PHASE(CRYPTO_STATS_OTP, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_OTP, length, length);
+
+    return length;
+}
+
+/*
+* same as feistel_encrypt_buf but splits the blocks across the pool, the output is identical
+*/
+size_t feistel_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, uint8_t **keys, size_t length){
+    uint32_t schedule[FEISTEL_ROUNDS];
+    struct par_job job = {.in = out, .out = out, .schedule = schedule, .decrypt = 0};
+    int round;
+    STATS_START(t);
+
+    job.size = preprocess_plaintext(plaintext, out, length);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_PREPROCESS, t);
+
+    for(round = 0; round < FEISTEL_ROUNDS; round++)
+        random_key_fill(keys[round], FEISTEL_BLOCK_SIZE / 2);
+    feistel_schedule(keys, schedule);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_KEY, t);
+
+    par_run(pool, &job, par_feistel_chunk);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_FEISTEL, length, job.size);
+
+    return job.size;
+}
+
+/*
+* same as feistel_decrypt_buf but splits the blocks across the pool, the output is identical
+*/
+size_t feistel_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, uint8_t **keys, size_t length){
+    uint32_t schedule[FEISTEL_ROUNDS];
+    struct par_job job = {.in = out, .out = out, .schedule = schedule, .decrypt = 1};
+    STATS_START(t);
+
+    job.size = FEISTEL_PADDED_SIZE(length);
+
+    if(out != ciphertext)
+        memmove(out, ciphertext, job.size);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_PREPROCESS, t);
+
+    feistel_schedule(keys, schedule);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_KEY, t);
+
+    par_run(pool, &job, par_feistel_chunk);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_FEISTEL, length, job.size);
+
+    return job.size;
+}
+
+/*
+* same as feistel_ctr_crypt_at but splits the range across the pool, the output is identical
+*/
+size_t feistel_ctr_crypt_at_par(crypto_pool *pool, uint8_t *in, uint8_t *out, uint8_t **keys, uint32_t nonce,
+                                uint64_t offset, size_t length){
+    uint32_t schedule[FEISTEL_ROUNDS];
+    struct par_job job = {.in = in, .out = out, .schedule = schedule, .nonce = nonce, .offset = offset, .size = length};
+    STATS_START(t);
+
+    if(!feistel_ctr_fits(offset, length))
+        return 0;
+
+    feistel_schedule(keys, schedule);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_KEY, t);
+
+    par_run(pool, &job, par_feistel_ctr_chunk);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_FEISTEL, length, length);
+
+    return length;
+}
+
+/*
+* same as feistel_ctr_encrypt_buf but splits the input across the pool, the output is identical
+*/
+size_t feistel_ctr_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, uint8_t **keys, uint32_t nonce,
+                               size_t length){
+    return feistel_ctr_crypt_at_par(pool, plaintext, out, keys, nonce, 0, length);
+}
+
+/*
+* same as feistel_ctr_decrypt_buf but splits the input across the pool, the output is identical
+*/
+size_t feistel_ctr_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, uint8_t **keys, uint32_t nonce,
+                               size_t length){
+    return feistel_ctr_crypt_at_par(pool, ciphertext, out, keys, nonce, 0, length);
+}
+
+/*
+* same as feistel_params_encrypt_buf but splits the blocks across the pool, the output is identical
+*/
+size_t feistel_params_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, const feistel_params *params,
+                                  size_t length){
+    struct par_job job = {.in = out, .out = out, .fp = params, .decrypt = 0};
+    STATS_START(t);
+
+    job.size = FEISTEL_PARAMS_PADDED_SIZE(params, length);
+    if(out != plaintext)
+        memmove(out, plaintext, length);
+    memset(out + length, 0, job.size - length);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_PREPROCESS, t);
+
+    par_run(pool, &job, par_feistel_params_chunk);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_FEISTEL, length, job.size);
+
+    return job.size;
+}
+
+/*
+* same as feistel_params_decrypt_buf but splits the blocks across the pool, the output is identical
+*/
+size_t feistel_params_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, const feistel_params *params,
+                                  size_t length){
+    struct par_job job = {.in = out, .out = out, .fp = params, .decrypt = 1};
+    STATS_START(t);
+
+    job.size = FEISTEL_PARAMS_PADDED_SIZE(params, length);
+    if(out != ciphertext)
+        memmove(out, ciphertext, job.size);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_PREPROCESS, t);
+
+    par_run(pool, &job, par_feistel_params_chunk);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_FEISTEL, length, job.size);
+
+    return job.size;
+}
+
+/*
+* returns the shared pool of threads workers for the *_mt functions, making it on first use. NULL if it can not be
+* made, the blocks then run on the calling thread
+*/
+static crypto_pool *feistel_mt_pool(int threads){
+    crypto_pool *pool;
+
+    pthread_mutex_lock(&feistel_mt_lock);
+    pool = feistel_mt_pools[threads];
+    if(pool == NULL){
+        pool = crypto_pool_create(threads);
+        if(pool != NULL)
+            crypto_pool_set_threshold(pool, 0);
+        feistel_mt_pools[threads] = pool;
+    }
+    pthread_mutex_unlock(&feistel_mt_lock);
+
+    return pool;
+}
+
+/*
+* runs the blocks of a padded buffer on the shared pool of the given number of threads,
+* never more threads than there are FEISTEL_MT_MIN_BLOCKS chunks of blocks
+*/
+static void feistel_blocks_mt(uint8_t *data, size_t blocks, const uint32_t *schedule, int decrypt, int threads){
+    struct par_job job = {.in = data, .out = data, .schedule = schedule, .decrypt = decrypt};
+    crypto_pool *pool;
+
+    if(threads > FEISTEL_MAX_THREADS)
+        threads = FEISTEL_MAX_THREADS;
+
+    // not worth a thread for less than a chunk of blocks each
+    if((size_t)threads > blocks / FEISTEL_MT_MIN_BLOCKS)
+        threads = blocks / FEISTEL_MT_MIN_BLOCKS;
+
+    pool = NULL;
+    if(threads > 1)
+        pool = feistel_mt_pool(threads);
+
+    job.size = blocks * FEISTEL_BLOCK_SIZE;
+    par_run(pool, &job, par_feistel_chunk);
+
+    return;
+}
+
+/*
+* same as feistel_encrypt_buf but splits the blocks across the given number of threads, the output is identical.
+* the pool of each thread count is made on the first call and reused by every later one
+*/
+size_t feistel_encrypt_mt(uint8_t *plaintext, uint8_t *out, uint8_t **keys, size_t length, int threads){
+    uint32_t schedule[FEISTEL_ROUNDS];
+    size_t size;
+    int round;
+    STATS_START(t);
+
+    size = preprocess_plaintext(plaintext, out, length);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_PREPROCESS, t);
+
+    for(round = 0; round < FEISTEL_ROUNDS; round++)
+        random_key_fill(keys[round], FEISTEL_BLOCK_SIZE / 2);
+    feistel_schedule(keys, schedule);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_KEY, t);
+
+    feistel_blocks_mt(out, size / FEISTEL_BLOCK_SIZE, schedule, 0, threads);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_FEISTEL, length, size);
+
+    return size;
+}
+
+/*
+* same as feistel_decrypt_buf but splits the blocks across the given number of threads, the output is identical.
+* the pool of each thread count is made on the first call and reused by every later one
+*/
+size_t feistel_decrypt_mt(uint8_t *ciphertext, uint8_t *out, uint8_t **keys, size_t length, int threads){
+    uint32_t schedule[FEISTEL_ROUNDS];
+    size_t size;
+    STATS_START(t);
+
+    size = FEISTEL_PADDED_SIZE(length);
+
+    if(out != ciphertext)
+        memmove(out, ciphertext, size);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_PREPROCESS, t);
+
+    feistel_schedule(keys, schedule);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_KEY, t);
+
+    feistel_blocks_mt(out, size / FEISTEL_BLOCK_SIZE, schedule, 1, threads);
+    STATS_PHASE(CRYPTO_STATS_FEISTEL, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_FEISTEL, length, size);
+
+    return size;
+}
+
+/*
+* fills the 25 cells of a grid row by row from key, then with the rest of the alphabet leaving out I
+*/
+static void playfair_fill_grid(uint8_t *key, uint8_t *grid){
+    uint8_t alphabet[26] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z'};
+    int used[26], i, k, filled;
+
+    // calloc didnt work ok
+    for(i = 0; i < 26; i++)
+        used[i] = 0;
+
+    // fill initial key
+    filled = 0;
+    for(k = 0; key[k] != '\0' && filled < 25; k++){
+        // check if already used
+        if((key[k] >= 'A' && key[k] <= 'Z') && !used[key[k] - 'A']){
+            grid[filled++] = key[k];
+
+            // set used
+            used[key[k] - 'A'] = 1;
+        }
+    }
+
+    // fill rest of the alphabet
+    for(k = 0; filled < 25; k++){
+        // check if used
+        if(!used[k] && alphabet[k] != 'I'){
+            grid[filled++] = alphabet[k];
+            used[k] = 1;
+        }
+    }
+
+    return;
+}
+
+/*
+* structs the keymatrix made from key by filling the rest of the alphabet and replacing Is with Js
+*/
+uint8_t **playfair_keymatrix(uint8_t *key){
+    uint8_t **keymatrix, grid[25];
+    int i;
+    STATS_START(t);
+
+    playfair_fill_grid(key, grid);
+
+    // 2d array
+    keymatrix = (uint8_t**)arena_get(5 * sizeof(uint8_t*));
+    STATS_ALLOC(CRYPTO_STATS_PLAYFAIR, 5 * sizeof(uint8_t*));
+
+    for(i = 0; i < 5; i++){
+        keymatrix[i] = (uint8_t*)arena_get(5 * sizeof(uint8_t));
+        STATS_ALLOC(CRYPTO_STATS_PLAYFAIR, 5 * sizeof(uint8_t));
+        memcpy(keymatrix[i], grid + (i * 5), 5);
+    }
+    STATS_PHASE(CRYPTO_STATS_PLAYFAIR, CRYPTO_PHASE_KEY, t);
+
+    return keymatrix;
+}
+
+/*
+* matches the given 2 characters on the key grid through the position index, shifting by step (1 to encrypt, 4 to
+* decrypt as -1 mod 5) on a shared row or column. a pair with a character not on the grid is copied unchanged
+*/
+static void playfair_index_match(const playfair_key *key, const uint8_t *text, uint8_t *encoded, int step){
+    uint8_t a, b;
+    int i1, i2, j1, j2;
+
+    a = text[0] - 'A';
+    b = text[1] - 'A';
+
+    if(a >= 26 || b >= 26 || key->row[a] == PLAYFAIR_NONE || key->row[b] == PLAYFAIR_NONE){
+        encoded[0] = text[0];
+        encoded[1] = text[1];
+        return;
+    }
+
+    i1 = key->row[a];
+    j1 = key->col[a];
+    i2 = key->row[b];
+    j2 = key->col[b];
+
+    if(i1 == i2){ // same row
+        encoded[0] = key->grid[(i1 * 5) + ((j1 + step) % 5)];
+        encoded[1] = key->grid[(i2 * 5) + ((j2 + step) % 5)];
+    }else if(j1 == j2){ // same column
+        encoded[0] = key->grid[(((i1 + step) % 5) * 5) + j1];
+        encoded[1] = key->grid[(((i2 + step) % 5) * 5) + j2];
+    }else{ // square
+        encoded[0] = key->grid[(i1 * 5) + j2];
+        encoded[1] = key->grid[(i2 * 5) + j1];
+    }
+
+    return;
+}
+
+/*
+* matches the given 2 characters on the key in an encryption fashion (positive) and writes the encrypted ones into encoded
+* (may be text itself), one load from the digram table when the key has them
+*/
+static inline void playfair_encrypt_match(const playfair_key *key, const uint8_t *text, uint8_t *encoded){
+    uint8_t a, b;
+
+    a = text[0] - 'A';
+    b = text[1] - 'A';
+
+    if(key->tables && a < 26 && b < 26){
+        memcpy(encoded, key->enc[(a * 26) + b], 2);
+        return;
+    }
+
+    playfair_index_match(key, text, encoded, 1);
+
+    return;
+}
+
+/*
+* matches the given 2 characters on the key in a decryption fashion (negative) and writes the decrypted ones into encoded
+* (may be text itself), one load from the digram table when the key has them
+*/
+static inline void playfair_decrypt_match(const playfair_key *key, const uint8_t *text, uint8_t *encoded){
+    uint8_t a, b;
+
+    a = text[0] - 'A';
+    b = text[1] - 'A';
+
+    if(key->tables && a < 26 && b < 26){
+        memcpy(encoded, key->dec[(a * 26) + b], 2);
+        return;
+    }
+
+    playfair_index_match(key, text, encoded, 4);
+
+    return;
+}
+
+/*
+* builds the position index of a filled grid and, if asked, the 676 entry encrypt/decrypt digram tables
+*/
+static void playfair_key_index(playfair_key *key, int tables){
+    uint8_t digram[2];
+    int i, a, b;
+
+    memset(key->row, PLAYFAIR_NONE, sizeof(key->row));
+    memset(key->col, PLAYFAIR_NONE, sizeof(key->col));
+
+    for(i = 0; i < 25; i++){
+        if(key->grid[i] >= 'A' && key->grid[i] <= 'Z'){
+            key->row[key->grid[i] - 'A'] = i / 5;
+            key->col[key->grid[i] - 'A'] = i % 5;
+        }
+    }
+
+    key->tables = 0;
+    if(!tables)
+        return;
+
+    for(a = 0; a < 26; a++){
+        for(b = 0; b < 26; b++){
+            digram[0] = 'A' + a;
+            digram[1] = 'A' + b;
+            playfair_index_match(key, digram, key->enc[(a * 26) + b], 1);
+            playfair_index_match(key, digram, key->dec[(a * 26) + b], 4);
+        }
+    }
+    key->tables = 1;
+
+    return;
+}
+
+/*
+* sets up a playfair key from the key string like playfair_keymatrix, tables also precomputes every digram
+*/
+void playfair_key_init(playfair_key *key, uint8_t *keystring, int tables){
+    STATS_START(t);
+
+    playfair_fill_grid(keystring, key->grid);
+    playfair_key_index(key, tables);
+    STATS_PHASE(CRYPTO_STATS_PLAYFAIR, CRYPTO_PHASE_KEY, t);
+
+    return;
+}
+
+/*
+* sets up a playfair key from a keymatrix made by playfair_keymatrix
+*/
+void playfair_key_from_matrix(playfair_key *key, uint8_t **keymatrix, int tables){
+    int i;
+    STATS_START(t);
+
+    for(i = 0; i < 5; i++)
+        memcpy(key->grid + (i * 5), keymatrix[i], 5);
+    playfair_key_index(key, tables);
+    STATS_PHASE(CRYPTO_STATS_PLAYFAIR, CRYPTO_PHASE_KEY, t);
+
+    return;
+}
+
+/*
+* adds letter c to the digram stream, pairing it with the pending first letter (-1 if none) and setting X on double
+* chars. returns 2 if it completed a digram, which is encrypted into out
+*/
+static inline size_t playfair_encrypt_letter(const playfair_key *key, uint8_t c, int *first, uint8_t *out){
+    uint8_t digram[2];
+
+    if(*first < 0){
+        *first = c;
+        return 0;
+    }
+
+    // check if second should be X
+    digram[0] = *first;
+    digram[1] = (c == *first) ? 'X' : c;
+    *first = -1;
+
+    playfair_encrypt_match(key, digram, out);
+
+    return 2;
+}
+
+/*
+* filters, swaps Is for Js, sets X on double chars and encrypts the digrams of size bytes of in in one forward pass.
+* with a simd filter every PLAYFAIR_SCAN_BLOCK bytes are first packed down to their letters (Is already Js) into a
+* stack buffer and paired from there. an unpaired character is carried in and out through pending (-1 if none).
+* out never gets ahead of the block being read, so it may be in itself, returns the bytes written
+*/
+static size_t playfair_encrypt_scan(const playfair_key *key, const uint8_t *in, uint8_t *out, size_t size, int *pending){
+    const simd_kernels *simd = simd_get();
+    uint8_t letters[PLAYFAIR_SCAN_BLOCK], c;
+    size_t block, i, n, kept, written;
+    int first;
+
+    first = *pending;
+    written = 0;
+
+    if(simd->letter_filter){
+        for(block = 0; block < size; block += n){
+            n = size - block < PLAYFAIR_SCAN_BLOCK ? size - block : PLAYFAIR_SCAN_BLOCK;
+            kept = simd->letter_filter(in + block, letters, n);
+
+            for(i = 0; i < kept; i++)
+                written += playfair_encrypt_letter(key, letters[i], &first, out + written);
+        }
+    }else{
+        for(i = 0; i < size; i++){
+            c = in[i];
+
+            // if not in alphabet
+            if(c < 'A' || c > 'Z')
+                continue;
+
+            // switch Is to Js
+            if(c == 'I')
+                c = 'J';
+
+            written += playfair_encrypt_letter(key, c, &first, out + written);
+        }
     }
-    ciphertext[i * 2] = '\0';
+    *pending = first;
+
+    return written;
+}
+
+/*
+* encrypts length bytes of plaintext using given key into out, which must hold length + 1 bytes
+* (out may be the plaintext itself), returns the number of bytes written
+*/
+size_t playfair_encrypt_buf(uint8_t *plaintext, uint8_t *out, const playfair_key *key, size_t length){
+    uint8_t digram[2];
+    size_t size;
+    int pending;
+    STATS_START(t);
+
+    pending = -1;
+    size = playfair_encrypt_scan(key, plaintext, out, length, &pending);
+
+    // if odd, pair the last char with an X
+    if(pending >= 0){
+        digram[0] = pending;
+        digram[1] = 'X';
+        playfair_encrypt_match(key, digram, out + size);
+        size += 2;
+    }
+    STATS_PHASE(CRYPTO_STATS_PLAYFAIR, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_PLAYFAIR, length, size);
+
+    return size;
+}
+
+/*
+* encrypts given plaintext using given keymatrix
+*/
+uint8_t *playfair_encrypt(uint8_t *plaintext, uint8_t **key, size_t length){
+    uint8_t *ciphertext;
+    playfair_key pk;
+    size_t size;
+
+    playfair_key_from_matrix(&pk, key, 0);
+
+    ciphertext = (uint8_t*)arena_get((length + 2) * sizeof(uint8_t));
+    STATS_ALLOC(CRYPTO_STATS_PLAYFAIR, length + 2);
+    size = playfair_encrypt_buf(plaintext, ciphertext, &pk, length);
+    ciphertext[size] = '\0';
 
     return ciphertext;
 }
 
+/*
+* decrypts length bytes of ciphertext using playfair and given key into out, which must hold length bytes
+* (out may be the ciphertext itself), returns the number of bytes written
+*/
+size_t playfair_decrypt_buf(uint8_t *ciphertext, uint8_t *out, const playfair_key *key, size_t length){
+    size_t i, blocks;
+    STATS_START(t);
+
+    blocks = length / 2;
+
+    // for every 2 byte block, decrypt on matrix
+    for(i = 0; i < blocks; i++)
+        playfair_decrypt_match(key, ciphertext + (i * 2), out + (i * 2));
+    STATS_PHASE(CRYPTO_STATS_PLAYFAIR, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_PLAYFAIR, length, blocks * 2);
+
+    return blocks * 2;
+}
+
 /*
 * decrypts the given ciphertext using playfair and given keymatrix
 */
-uint8_t *playfair_decrypt(uint8_t *ciphertext, uint8_t **key){
-    uint8_t *plaintext, *processed, *encrypted, *text;
-    int i, k, size, blocks;
+uint8_t *playfair_decrypt(uint8_t *ciphertext, uint8_t **key, size_t length){
+    uint8_t *plaintext;
+    playfair_key pk;
+    size_t size;
+
+    playfair_key_from_matrix(&pk, key, 0);
+
+    plaintext = (uint8_t*)arena_get((length + 1) * sizeof(uint8_t));
+    STATS_ALLOC(CRYPTO_STATS_PLAYFAIR, length + 1);
+    size = playfair_decrypt_buf(ciphertext, plaintext, &pk, length);
+    plaintext[size] = '\0';
+
+    return plaintext;
+}
+
+/*
+* starts streaming playfair with given key, encrypting or decrypting
+*/
+void playfair_ctx_init(playfair_ctx *ctx, const playfair_key *key, int decrypt){
+    ctx->key = key;
+    ctx->pending = -1;
+    ctx->decrypt = decrypt;
+
+    return;
+}
+
+/*
+* transforms the digrams completed by the next size bytes into out, which must hold size + 1 bytes and not overlap in,
+* keeps an unpaired character for the next call and returns the bytes written.
+* encryption filters, swaps Is for Js and sets X on double chars on the fly like playfair_encrypt
+*/
+size_t playfair_ctx_update(playfair_ctx *ctx, uint8_t *in, uint8_t *out, size_t size){
+    uint8_t digram[2];
+    size_t i, written;
+    STATS_START(t);
+
+    if(!ctx->decrypt){
+        written = playfair_encrypt_scan(ctx->key, in, out, size, &ctx->pending);
+        STATS_PHASE(CRYPTO_STATS_PLAYFAIR, CRYPTO_PHASE_TRANSFORM, t);
+        STATS_CALL(CRYPTO_STATS_PLAYFAIR, size, written);
+        return written;
+    }
+
+    for(i = 0, written = 0; i < size; i++){
+        if(ctx->pending < 0){
+            ctx->pending = in[i];
+            continue;
+        }
+
+        digram[0] = ctx->pending;
+        digram[1] = in[i];
+        ctx->pending = -1;
 
-    size = strlen(ciphertext);
-    blocks = size / 2;
-    text = (uint8_t*)malloc(2 * sizeof(uint8_t));
-    plaintext = (uint8_t*)malloc((size + 1) * sizeof(uint8_t));
+        playfair_decrypt_match(ctx->key, digram, out + written);
+        written += 2;
+    }
+    STATS_PHASE(CRYPTO_STATS_PLAYFAIR, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_PLAYFAIR, size, written);
 
-    // for every 2 byte block
-    for(i = 0; i < blocks; i++){
-        // get encrypted
-        text[0] = ciphertext[i * 2];
-        text[1] = ciphertext[(i * 2) + 1];
+    return written;
+}
 
-        // decrypt on amtrix
-        encrypted = playfair_decrypt_match(key, text);
+/*
+* ends the stream, encryption pairs a leftover character with an X into out (2 bytes), decryption drops it like
+* playfair_decrypt, returns the bytes written
+*/
+size_t playfair_ctx_final(playfair_ctx *ctx, uint8_t *out){
+    uint8_t digram[2];
+    STATS_START(t);
 
-        // set decrypted
-        plaintext[i * 2] = encrypted[0];
-        plaintext[(i * 2) + 1] = encrypted[1];
+    if(ctx->pending < 0 || ctx->decrypt){
+        ctx->pending = -1;
+        return 0;
     }
 
-    plaintext[i * 2] = '\0';
+    digram[0] = ctx->pending;
+    digram[1] = 'X';
+    playfair_encrypt_match(ctx->key, digram, out);
+    ctx->pending = -1;
+    STATS_PHASE(CRYPTO_STATS_PLAYFAIR, CRYPTO_PHASE_TRANSFORM, t);
 
-    return plaintext;
-}
\ No newline at end of file
+    // the input was counted by the update that kept the letter
+    STATS_CALL(CRYPTO_STATS_PLAYFAIR, 0, 2);
+
+    return 2;
+}
+
+/*
+* counts the playfair letters of a chunk and finds its last one, the first phase of the parallel compaction
+*/
+static void par_playfair_count(void *arg, size_t chunk){
+    struct par_job *job = (struct par_job*)arg;
+    size_t offset, size, i, letters;
+
+    offset = par_slice(job, chunk, &size);
+    for(i = 0, letters = 0; i < size; i++)
+        letters += job->in[offset + i] >= 'A' && job->in[offset + i] <= 'Z';
+    job->counts[chunk] = letters;
+
+    job->lasts[chunk] = 0;
+    for(i = size; letters > 0 && i-- > 0;){
+        if(job->in[offset + i] >= 'A' && job->in[offset + i] <= 'Z'){
+            job->lasts[chunk] = (job->in[offset + i] == 'I') ? 'J' : job->in[offset + i];
+            break;
+        }
+    }
+
+    return;
+}
+
+/*
+* scatters the letters of a chunk to their place in the digram stream and encrypts every digram whose second letter
+* is in the chunk. a digram started before the chunk gets its first letter from the prefix pass, so no chunk reads
+* outside its own slice. the last letter of an odd stream is paired with an X
+*/
+static void par_playfair_scatter(void *arg, size_t chunk){
+    struct par_job *job = (struct par_job*)arg;
+    size_t offset, size, i, position, start;
+    uint8_t digram[2], c;
+    int first;
+
+    offset = par_slice(job, chunk, &size);
+    position = start = job->counts[chunk];
+
+    // odd position, the digram started before this chunk
+    first = (position % 2 != 0) ? job->lasts[chunk] : -1;
+
+    for(i = 0; i < size; i++){
+        c = job->in[offset + i];
+
+        // if not in alphabet
+        if(c < 'A' || c > 'Z')
+            continue;
+
+        // switch Is to Js
+        if(c == 'I')
+            c = 'J';
+        position++;
+
+        if(first < 0){
+            first = c;
+            continue;
+        }
+
+        // check if second should be X
+        digram[0] = first;
+        digram[1] = (c == first) ? 'X' : c;
+        first = -1;
+        playfair_encrypt_match(job->pk, digram, job->out + position - 2);
+    }
+
+    // a pending letter belongs to the next chunk's first digram unless it ends the stream. only the chunk holding
+    // that letter pairs it, a chunk without letters after it was only handed it
+    if(first >= 0 && position == job->letters && position > start){
+        digram[0] = first;
+        digram[1] = 'X';
+        playfair_encrypt_match(job->pk, digram, job->out + position - 1);
+    }
+
+    return;
+}
+
+static void par_playfair_decrypt(void *arg, size_t chunk){
+    struct par_job *job = (struct par_job*)arg;
+    size_t offset, size, i;
+
+    offset = par_slice(job, chunk, &size);
+    for(i = 0; i + 1 < size; i += 2)
+        playfair_decrypt_match(job->pk, job->in + offset + i, job->out + offset + i);
+
+    return;
+}
+
+/*
+* same as playfair_encrypt_buf but splits the input across the pool, the output is identical.
+* the letters are counted per chunk, a prefix sum gives every chunk its place in the digram stream and the chunks then
+* scatter and encrypt their digrams independently. out must not overlap plaintext, or it runs on the calling thread
+*/
+size_t playfair_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, const playfair_key *key, size_t length){
+    struct par_job job = {.in = plaintext, .out = out, .pk = key, .size = length, .chunk = CRYPTO_PAR_CHUNK};
+    size_t chunks, chunk, letters, count;
+    uint8_t last, c;
+    STATS_START(t);
+
+    if(pool == NULL || length < crypto_pool_threshold(pool) || crypto_pool_threads(pool) <= 1 ||
+       (out < plaintext + length && plaintext < out + length + 1))
+        return playfair_encrypt_buf(plaintext, out, key, length);
+
+    chunks = (length + CRYPTO_PAR_CHUNK - 1) / CRYPTO_PAR_CHUNK;
+    job.counts = (size_t*)arena_get(chunks * (sizeof(size_t) + 1));
+    STATS_ALLOC(CRYPTO_STATS_PLAYFAIR, chunks * (sizeof(size_t) + 1));
+    if(job.counts == NULL)
+        return playfair_encrypt_buf(plaintext, out, key, length);
+    job.lasts = (uint8_t*)(job.counts + chunks);
+
+    pool_run(pool, chunks, par_playfair_count, &job);
+
+    // exclusive prefix sum, every chunk's first letter position in the stream and the last letter before the chunk
+    for(chunk = 0, letters = 0, last = 0; chunk < chunks; chunk++){
+        count = job.counts[chunk];
+        job.counts[chunk] = letters;
+        letters += count;
+        c = job.lasts[chunk];
+        job.lasts[chunk] = last;
+        if(count > 0)
+            last = c;
+    }
+    job.letters = letters;
+
+    pool_run(pool, chunks, par_playfair_scatter, &job);
+    arena_put(job.counts, chunks * (sizeof(size_t) + 1));
+    STATS_PHASE(CRYPTO_STATS_PLAYFAIR, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_PLAYFAIR, length, letters + (letters % 2));
+
+    // odd streams end with the X paired digram
+    return letters + (letters % 2);
+}
+
+/*
+* same as playfair_decrypt_buf but splits the digrams across the pool, the output is identical
+*/
+size_t playfair_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, const playfair_key *key, size_t length){
+    struct par_job job = {.in = ciphertext, .out = out, .pk = key, .size = (length / 2) * 2};
+    STATS_START(t);
+
+    par_run(pool, &job, par_playfair_decrypt);
+    STATS_PHASE(CRYPTO_STATS_PLAYFAIR, CRYPTO_PHASE_TRANSFORM, t);
+    STATS_CALL(CRYPTO_STATS_PLAYFAIR, length, job.size);
+
+    return job.size;
+}
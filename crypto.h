@@ -1,7 +1,8 @@
-#ifndef __CRYPTO_H___
+#ifndef __CRYPTO_H__
 #define __CRYPTO_H__
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define AFFINE_MULT         11
 #define AFFINE_INC          19
@@ -9,67 +10,769 @@
 #define FEISTEL_BLOCK_SIZE  8
 #define FEISTEL_ROUNDS      8
 
+#define FEISTEL_CTR_BATCH   512     // keystream blocks the counter mode generates at a time
+#define FEISTEL_CTR_MAX_LENGTH ((uint64_t)FEISTEL_BLOCK_SIZE << 32) // longest counter mode stream, 2^32 blocks a nonce
+#define FEISTEL_MAX_THREADS 64      // upper bound on workers of the *_mt feistel functions
+#define FEISTEL_MT_MIN_BLOCKS 4096  // fewest blocks a single feistel worker is handed
+
 #define MOD(A, B)           ((A % B) < (0) ? ((A % B) + B) : (A % B))
 
+// size of a feistel buffer holding L bytes once padded up to whole blocks
+#define FEISTEL_PADDED_SIZE(L)  ((((L) + FEISTEL_BLOCK_SIZE - 1) / FEISTEL_BLOCK_SIZE) * FEISTEL_BLOCK_SIZE)
+
+/*
+* every cipher takes its input as (pointer, length) and handles arbitrary binary data, the malloc returning ones
+* null terminate their result for convenience.
+* the *_buf variants below write into a caller supplied buffer instead of allocating the result, out may be the
+* input itself to transform in place, and they return the number of bytes written (no null terminator is added)
+*/
+
+#define DRBG_BUFFER_SIZE    4096    // bytes of keystream generated per refill
+
+/*
+* key material generator, chacha20 keyed once from getrandom() and refilled a whole batch at a time
+*/
+typedef struct drbg_ctx {
+    uint32_t key[8];
+    uint64_t counter;
+    size_t available;                   // unread bytes at the tail of buffer
+    int seeded;                         // fixed seed, never reseeded from the kernel
+    int pid;                            // process that seeded it, a forked child reseeds
+    uint8_t buffer[DRBG_BUFFER_SIZE];
+} drbg_ctx;
+
+/*
+* seeds the generator once from the kernel, returns 0 on success and -1 if no seed could be read
+*/
+int drbg_init(drbg_ctx *ctx);
+
+/*
+* seeds the generator from a fixed value so the same stream is produced on every run, meant for benchmarks and tests
+*/
+void drbg_init_seeded(drbg_ctx *ctx, uint64_t seed);
+
+/*
+* copies size bytes of key material into out, refilling the batch buffer whenever it runs dry. a generator seeded
+* from the kernel reseeds in a forked child before handing out anything
+*/
+void drbg_generate(drbg_ctx *ctx, uint8_t *out, size_t size);
+
+/*
+* returns the calling thread's generator used for key creation, seeding it on first use and aborting if it can not
+* be seeded
+*/
+drbg_ctx *drbg_default(void);
+
 /*
-* grabs a random byte stream of given size from /dev/urandom
+* creates a random byte stream of given size from the calling thread's key generator
 */
-uint8_t *random_key_create(long size);
+uint8_t *random_key_create(size_t size);
+
+/*
+* fills the given buffer with size random bytes from the calling thread's key generator, without allocating
+*/
+void random_key_fill(uint8_t *data, size_t size);
+
+/*
+* switches the calling thread's key generator to the reproducible stream of the given seed
+*/
+void random_key_seed(uint64_t seed);
+
+/*
+* name of the instruction set the byte ciphers run on (scalar, sse2, avx2, avx512 or avx512vbmi2), picked from cpuid
+* at startup
+*/
+const char *crypto_simd_name(void);
+
+/*
+* 256 entry byte substitution built once per (cipher, key), enc for encryption and dec for its inverse
+*/
+typedef struct subst_table {
+    uint8_t enc[256];
+    uint8_t dec[256];
+} subst_table;
+
+/*
+* builds the caesar tables for key N, 0-9A-Za-z shift around the 62 symbol alphabet and everything else maps to itself
+*/
+void caesar_table_init(subst_table *table, uint16_t N);
+
+/*
+* builds the affine tables for the linear function defined in crypto.h, only A-Z is substituted
+*/
+void affine_table_init(subst_table *table);
+
+/*
+* affine key for a * x + b: the function, its inverse and both tables computed once, so encrypting or decrypting
+* with it has no per call setup
+*/
+typedef struct affine_key {
+    int mult;
+    int inc;
+    int dec_mult;       // inverse function dec_mult * x + dec_inc
+    int dec_inc;
+    subst_table table;
+} affine_key;
+
+/*
+* sets up an affine key for a * x + b, computing the inverse function and both tables once.
+* returns 0, or -1 leaving the key untouched if a has no inverse (gcd(a, 26) != 1)
+*/
+int affine_key_init(affine_key *key, int a, int b);
+
+/*
+* transforms size bytes of in into out (may be in itself) through one of the halves of a substitution table,
+* e.g. subst_apply(table.enc, ...) to encrypt, returns the number of bytes written
+*/
+size_t subst_apply(const uint8_t *table, uint8_t *in, uint8_t *out, size_t size);
 
 /*
 * encrypts given plaintext using caesar's cipher and key N
 */
-uint8_t* caesar_encrypt(uint8_t *plaintext, uint16_t N);
+uint8_t* caesar_encrypt(uint8_t *plaintext, uint16_t N, size_t length);
+
+/*
+* encrypts length bytes of plaintext using caesar's cipher and key N into out, which must hold length bytes
+*/
+size_t caesar_encrypt_buf(uint8_t *plaintext, uint8_t *out, uint16_t N, size_t length);
 
 /*
 * decrypts given ciphertext using caesar's cipher and key N
 */
-uint8_t* caesar_decrypt(uint8_t *ciphertext, uint16_t N);
+uint8_t* caesar_decrypt(uint8_t *ciphertext, uint16_t N, size_t length);
+
+/*
+* decrypts length bytes of ciphertext using caesar's cipher and key N into out, which must hold length bytes
+*/
+size_t caesar_decrypt_buf(uint8_t *ciphertext, uint8_t *out, uint16_t N, size_t length);
 
 /*
 * encrypts given plaintext using affine cipher using the linear function defined in cs457_crypto.h
 */
-uint8_t* affine_encrypt(uint8_t *plaintext);
+uint8_t* affine_encrypt(uint8_t *plaintext, size_t length);
+
+/*
+* encrypts given plaintext using affine cipher and given key, returns a null terminated malloc'ed copy
+*/
+uint8_t* affine_key_encrypt(uint8_t *plaintext, const affine_key *key, size_t length);
+
+/*
+* encrypts length bytes of plaintext using affine cipher and given key into out, which must hold length bytes
+*/
+size_t affine_encrypt_buf(uint8_t *plaintext, uint8_t *out, const affine_key *key, size_t length);
 
 /*
 * decrypts given plaintext using affine cipher using the linear function defined in cs457_crypto.h
 */
-uint8_t* affine_decrypt(uint8_t *ciphertext);
+uint8_t* affine_decrypt(uint8_t *ciphertext, size_t length);
+
+/*
+* decrypts given ciphertext using affine cipher and given key, returns a null terminated malloc'ed copy
+*/
+uint8_t* affine_key_decrypt(uint8_t *ciphertext, const affine_key *key, size_t length);
+
+/*
+* decrypts length bytes of ciphertext using affine cipher and given key into out, which must hold length bytes
+*/
+size_t affine_decrypt_buf(uint8_t *ciphertext, uint8_t *out, const affine_key *key, size_t length);
 
 /*
 * encrypts given plaintext using one time pad, xoring every byte of the plaintext with every byte of the key
 */
-uint8_t* otp_encrypt(uint8_t *plaintext, uint8_t* key, uint16_t length);
+uint8_t* otp_encrypt(uint8_t *plaintext, uint8_t* key, size_t length);
+
+/*
+* encrypts length bytes of plaintext using one time pad into out, which must hold length bytes
+*/
+size_t otp_encrypt_buf(uint8_t *plaintext, uint8_t *out, uint8_t* key, size_t length);
 
 /*
 * decrypts given ciphertext using one time pad, xoring every byte of the ciphertext with every byte of the key
 */
-uint8_t* otp_decrypt(uint8_t *ciphertext, uint8_t* key, uint16_t length);
+uint8_t* otp_decrypt(uint8_t *ciphertext, uint8_t* key, size_t length);
+
+/*
+* decrypts length bytes of ciphertext using one time pad into out, which must hold length bytes
+*/
+size_t otp_decrypt_buf(uint8_t *ciphertext, uint8_t *out, uint8_t* key, size_t length);
 
 /*
 * encrypt the given plaintext with the feistel algorithm, running for FEISTEL_ROUNDS rounds (defined in cs457_crypto.h) and creating a random key each round,
 * storing it in the corresponding row of keys matrix
 */
-uint8_t* feistel_encrypt(uint8_t *plaintext, uint8_t **keys, uint16_t length);
+uint8_t* feistel_encrypt(uint8_t *plaintext, uint8_t **keys, size_t length);
+
+/*
+* encrypts length bytes of plaintext with feistel into out, which must hold FEISTEL_PADDED_SIZE(length) bytes, storing the round keys in keys
+*/
+size_t feistel_encrypt_buf(uint8_t *plaintext, uint8_t *out, uint8_t **keys, size_t length);
 
 /*
 * decrypts ciphertext using feistel and using the keys the encrypt function created
 */
-uint8_t* feistel_decrypt(uint8_t *ciphertext, uint8_t **keys, uint16_t length);
+uint8_t* feistel_decrypt(uint8_t *ciphertext, uint8_t **keys, size_t length);
+
+/*
+* decrypts length bytes of ciphertext with feistel into out, which must hold FEISTEL_PADDED_SIZE(length) bytes, using the keys the encrypt function created
+*/
+size_t feistel_decrypt_buf(uint8_t *ciphertext, uint8_t *out, uint8_t **keys, size_t length);
+
+/*
+* same as feistel_encrypt_buf but splits the blocks across the given number of threads, the output is identical.
+* the pool of each thread count is made on the first call and reused by every later one
+*/
+size_t feistel_encrypt_mt(uint8_t *plaintext, uint8_t *out, uint8_t **keys, size_t length, int threads);
+
+/*
+* same as feistel_decrypt_buf but splits the blocks across the given number of threads, the output is identical.
+* the pool of each thread count is made on the first call and reused by every later one
+*/
+size_t feistel_decrypt_mt(uint8_t *ciphertext, uint8_t *out, uint8_t **keys, size_t length, int threads);
+
+/*
+* feistel in counter mode: block i of the stream is xored with the feistel encryption of the 64 bit counter holding
+* the 32 bit nonce in its high half and i in its low half (stored in host byte order), so the output is as long as the
+* input with no padding, every block can be computed on its own and any byte range decrypts without the rest. streams
+* under different nonces never share a counter, which caps a stream at FEISTEL_CTR_MAX_LENGTH bytes. the round keys
+* are the caller's (e.g. filled with random_key_fill or left by feistel_encrypt) and a nonce must never repeat under
+* the same keys
+*/
+
+/*
+* encrypts length bytes of plaintext with feistel in counter mode into out, which must hold length bytes (out may be
+* the plaintext itself), using the round keys in keys and a nonce never used with them before. returns length, or 0
+* leaving out untouched if length is over FEISTEL_CTR_MAX_LENGTH
+*/
+size_t feistel_ctr_encrypt_buf(uint8_t *plaintext, uint8_t *out, uint8_t **keys, uint32_t nonce, size_t length);
+
+/*
+* decrypts length bytes of ciphertext made by feistel_ctr_encrypt_buf with the same keys and nonce into out, which
+* must hold length bytes (out may be the ciphertext itself). returns length, or 0 if it is over FEISTEL_CTR_MAX_LENGTH
+*/
+size_t feistel_ctr_decrypt_buf(uint8_t *ciphertext, uint8_t *out, uint8_t **keys, uint32_t nonce, size_t length);
+
+/*
+* encrypts or decrypts (the same in counter mode) length bytes of in that sit at byte offset of the whole stream into
+* out, which must hold length bytes (out may be in itself). only the blocks covering the range are generated, so a
+* record in the middle of a large file decrypts without touching the rest. returns length, or 0 leaving out untouched
+* if the range runs past FEISTEL_CTR_MAX_LENGTH
+*/
+size_t feistel_ctr_crypt_at(uint8_t *in, uint8_t *out, uint8_t **keys, uint32_t nonce, uint64_t offset, size_t length);
+
+#define FEISTEL_MAX_BLOCK   32      // largest block size a feistel_params takes
+#define FEISTEL_MAX_ROUNDS  64      // most rounds a feistel_params takes
+
+// size of a buffer holding L bytes once padded up to whole blocks of the feistel params P
+#define FEISTEL_PARAMS_PADDED_SIZE(P, L)    ((((L) + (P)->block_size - 1) / (P)->block_size) * (P)->block_size)
+
+/*
+* feistel with its block size (8, 16 or 32 bytes) and round count picked at runtime. the round function is the same
+* byte lane multiply over halves of block_size / 2 bytes, and 8 byte blocks with FEISTEL_ROUNDS rounds give the same
+* ciphertext as feistel_encrypt_buf for the same keys. the round keys sit back to back in keys and are spread once
+* over the lanes of the kernel picked for the block size, so a call has no key setup
+*/
+typedef struct feistel_params {
+    int block_size;
+    int rounds;
+    uint8_t keys[FEISTEL_MAX_ROUNDS * FEISTEL_MAX_BLOCK / 2];                  // block_size / 2 bytes per round
+    uint8_t lanes[2][FEISTEL_MAX_ROUNDS][FEISTEL_MAX_BLOCK] __attribute__((aligned(32))); // encrypt, decrypt
+} feistel_params;
+
+/*
+* sets up feistel for block_size (8, 16 or 32) byte blocks and 1 to FEISTEL_MAX_ROUNDS rounds with fresh random round
+* keys. returns 0, or -1 leaving params untouched if the block size or round count is not supported
+*/
+int feistel_params_init(feistel_params *params, int block_size, int rounds);
+
+/*
+* replaces the round keys of params with rounds * block_size / 2 bytes of keys, round after round (e.g. the keys of
+* an earlier feistel_params_init to decrypt with)
+*/
+void feistel_params_set_keys(feistel_params *params, const uint8_t *keys);
+
+/*
+* encrypts length bytes of plaintext with the feistel of params into out, which must hold
+* FEISTEL_PARAMS_PADDED_SIZE(params, length) bytes (out may be the plaintext itself), returns the bytes written
+*/
+size_t feistel_params_encrypt_buf(uint8_t *plaintext, uint8_t *out, const feistel_params *params, size_t length);
+
+/*
+* decrypts length bytes of ciphertext with the feistel of params into out, which must hold
+* FEISTEL_PARAMS_PADDED_SIZE(params, length) bytes (out may be the ciphertext itself), returns the bytes written
+*/
+size_t feistel_params_decrypt_buf(uint8_t *ciphertext, uint8_t *out, const feistel_params *params, size_t length);
+
+#define CRYPTO_POOL_MAX_THREADS 256     // upper bound on the participants of a crypto_pool
+#define CRYPTO_PAR_CHUNK    (64 << 10)  // bytes per chunk handed out by the *_par functions, a multiple of the feistel block
+#define CRYPTO_PAR_MIN_SIZE (1 << 20)   // default size below which the *_par functions stay on the calling thread
+
+/*
+* reusable thread pool for the *_par functions. the input is split in CRYPTO_PAR_CHUNK sized chunks, each thread starts
+* on its own contiguous share and steals chunks from the others once it runs out, writing straight into the output.
+* one job runs at a time, callers from several threads simply queue up
+*/
+typedef struct crypto_pool crypto_pool;
+
+/*
+* creates a pool of threads participants (the calling thread counts as one), 0 or less uses every online cpu.
+* returns NULL if it could not be set up
+*/
+crypto_pool *crypto_pool_create(int threads);
+
+/*
+* stops the workers and frees the pool
+*/
+void crypto_pool_destroy(crypto_pool *pool);
+
+/*
+* returns the number of participants of the pool, the calling thread included
+*/
+int crypto_pool_threads(const crypto_pool *pool);
+
+/*
+* sets the input size below which the *_par functions run on the calling thread alone
+*/
+void crypto_pool_set_threshold(crypto_pool *pool, size_t threshold);
+
+/*
+* returns the input size below which the *_par functions run on the calling thread alone
+*/
+size_t crypto_pool_threshold(const crypto_pool *pool);
+
+/*
+* same as caesar_encrypt_buf but splits the input across the pool, the output is identical
+*/
+size_t caesar_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, uint16_t N, size_t length);
+
+/*
+* same as caesar_decrypt_buf but splits the input across the pool, the output is identical
+*/
+size_t caesar_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, uint16_t N, size_t length);
+
+/*
+* same as affine_encrypt_buf but splits the input across the pool, the output is identical
+*/
+size_t affine_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, const affine_key *key, size_t length);
+
+/*
+* same as affine_decrypt_buf but splits the input across the pool, the output is identical
+*/
+size_t affine_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, const affine_key *key, size_t length);
+
+/*
+* same as otp_encrypt_buf but splits the xor across the pool, the output is identical
+*/
+size_t otp_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, uint8_t *key, size_t length);
+
+/*
+* same as otp_decrypt_buf but splits the xor across the pool, the output is identical
+*/
+size_t otp_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, uint8_t *key, size_t length);
+
+/*
+* same as feistel_encrypt_buf but splits the blocks across the pool, the output is identical
+*/
+size_t feistel_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, uint8_t **keys, size_t length);
+
+/*
+* same as feistel_decrypt_buf but splits the blocks across the pool, the output is identical
+*/
+size_t feistel_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, uint8_t **keys, size_t length);
+
+#define PLAYFAIR_NONE       0xff    // row/col of a letter that is not on the grid
+#define PLAYFAIR_SCAN_BLOCK 4096    // input bytes packed down to their letters at a time by the encrypt scan
+
+/*
+* compact playfair key: the 5x5 grid, a letter to (row, col) index and optionally every digram precomputed
+* (enc/dec[a * 26 + b] for letters a, b counted from A), so a digram is one indexed load instead of a grid scan
+*/
+typedef struct playfair_key {
+    uint8_t grid[25];
+    uint8_t row[26];
+    uint8_t col[26];
+    int tables;
+    uint8_t enc[26 * 26][2];
+    uint8_t dec[26 * 26][2];
+} playfair_key;
 
 /*
 * encrypts given plaintext using given keymatrix
 */
-uint8_t* playfair_encrypt(uint8_t *plaintext, uint8_t **key);
+uint8_t* playfair_encrypt(uint8_t *plaintext, uint8_t **key, size_t length);
+
+/*
+* encrypts length bytes of plaintext using given key into out, which must hold length + 1 bytes
+*/
+size_t playfair_encrypt_buf(uint8_t *plaintext, uint8_t *out, const playfair_key *key, size_t length);
 
 /*
 * decrypts the given ciphertext using playfair and given keymatrix
 */
-uint8_t* playfair_decrypt(uint8_t *ciphertext, uint8_t **key);
+uint8_t* playfair_decrypt(uint8_t *ciphertext, uint8_t **key, size_t length);
+
+/*
+* decrypts length bytes of ciphertext using playfair and given key into out, which must hold length bytes
+*/
+size_t playfair_decrypt_buf(uint8_t *ciphertext, uint8_t *out, const playfair_key *key, size_t length);
 
 /*
 * structs the keymatrix made from key by filling the rest of the alphabet and replacing Is with Js
 */
 uint8_t **playfair_keymatrix(uint8_t *key);
 
-#endif
\ No newline at end of file
+/*
+* sets up a playfair key from the key string like playfair_keymatrix, tables also precomputes every digram
+*/
+void playfair_key_init(playfair_key *key, uint8_t *keystring, int tables);
+
+/*
+* sets up a playfair key from a keymatrix made by playfair_keymatrix
+*/
+void playfair_key_from_matrix(playfair_key *key, uint8_t **keymatrix, int tables);
+
+/*
+* streaming contexts: init once, feed any number of chunks through *_ctx_update and finish with *_ctx_final.
+* a context only keeps the state needed across chunk boundaries so arbitrarily large inputs run in constant memory.
+* update/final return the number of bytes written to out
+*/
+typedef struct caesar_ctx {
+    uint16_t N;
+    int decrypt;
+} caesar_ctx;
+
+typedef struct affine_ctx {
+    const affine_key *key;
+    int decrypt;
+} affine_ctx;
+
+typedef struct otp_ctx {
+    uint8_t *key;
+    size_t offset;                      // key bytes used so far
+    int decrypt;
+} otp_ctx;
+
+typedef struct feistel_ctx {
+    uint32_t schedule[FEISTEL_ROUNDS];
+    uint8_t partial[FEISTEL_BLOCK_SIZE];  // bytes of a block not complete yet
+    int filled;
+    int decrypt;
+} feistel_ctx;
+
+typedef struct playfair_ctx {
+    const playfair_key *key;
+    int pending;                        // first char of a digram not complete yet, -1 if none
+    int decrypt;
+} playfair_ctx;
+
+/*
+* starts streaming caesar's cipher with key N, encrypting or decrypting
+*/
+void caesar_ctx_init(caesar_ctx *ctx, uint16_t N, int decrypt);
+
+/*
+* transforms the next size bytes into out, which must hold size bytes (may be in itself)
+*/
+size_t caesar_ctx_update(caesar_ctx *ctx, uint8_t *in, uint8_t *out, size_t size);
+
+/*
+* ends the stream, caesar keeps nothing across chunks so nothing is written. a no-op kept so every cipher streams
+* through the same init/update/final calls
+*/
+size_t caesar_ctx_final(caesar_ctx *ctx, uint8_t *out);
+
+/*
+* starts streaming the affine cipher with given key, encrypting or decrypting
+*/
+void affine_ctx_init(affine_ctx *ctx, const affine_key *key, int decrypt);
+
+/*
+* transforms the next size bytes into out, which must hold size bytes (may be in itself)
+*/
+size_t affine_ctx_update(affine_ctx *ctx, uint8_t *in, uint8_t *out, size_t size);
+
+/*
+* ends the stream, affine keeps nothing across chunks so nothing is written. a no-op kept so every cipher streams
+* through the same init/update/final calls
+*/
+size_t affine_ctx_final(affine_ctx *ctx, uint8_t *out);
+
+/*
+* starts streaming the one time pad with given key, which must be at least as long as the whole stream
+*/
+void otp_ctx_init(otp_ctx *ctx, uint8_t *key, int decrypt);
+
+/*
+* transforms the next size bytes into out, which must hold size bytes (may be in itself).
+* encryption drops characters outside the alphabet like otp_encrypt but does not pad the ciphertext for them
+*/
+size_t otp_ctx_update(otp_ctx *ctx, uint8_t *in, uint8_t *out, size_t size);
+
+/*
+* ends the stream, the key offset is all that is kept so nothing is written. a no-op kept so every cipher streams
+* through the same init/update/final calls
+*/
+size_t otp_ctx_final(otp_ctx *ctx, uint8_t *out);
+
+/*
+* starts streaming feistel, encryption creates a random key per round and stores it in keys like feistel_encrypt,
+* decryption uses the keys encryption created
+*/
+void feistel_ctx_init(feistel_ctx *ctx, uint8_t **keys, int decrypt);
+
+/*
+* transforms the whole blocks available after adding size bytes into out, which must hold size + FEISTEL_BLOCK_SIZE
+* bytes and not overlap in, the partial block is kept for the next call
+*/
+size_t feistel_ctx_update(feistel_ctx *ctx, uint8_t *in, uint8_t *out, size_t size);
+
+/*
+* ends the stream, null padding and transforming the partial block if there is one into out (FEISTEL_BLOCK_SIZE bytes)
+*/
+size_t feistel_ctx_final(feistel_ctx *ctx, uint8_t *out);
+
+/*
+* starts streaming playfair with given key, encrypting or decrypting
+*/
+void playfair_ctx_init(playfair_ctx *ctx, const playfair_key *key, int decrypt);
+
+/*
+* transforms the digrams completed by the next size bytes into out, which must hold size + 1 bytes and not overlap in,
+* an unpaired character is kept for the next call. encryption filters, swaps Is for Js and sets X on double chars
+*/
+size_t playfair_ctx_update(playfair_ctx *ctx, uint8_t *in, uint8_t *out, size_t size);
+
+/*
+* ends the stream, encryption pairs a leftover character with an X into out (2 bytes), decryption drops it
+*/
+size_t playfair_ctx_final(playfair_ctx *ctx, uint8_t *out);
+
+/*
+* same as feistel_params_encrypt_buf but splits the blocks across the pool, the output is identical
+*/
+size_t feistel_params_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, const feistel_params *params,
+                                  size_t length);
+
+/*
+* same as feistel_params_decrypt_buf but splits the blocks across the pool, the output is identical
+*/
+size_t feistel_params_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, const feistel_params *params,
+                                  size_t length);
+
+/*
+* same as feistel_ctr_encrypt_buf but splits the input across the pool, the output is identical
+*/
+size_t feistel_ctr_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, uint8_t **keys, uint32_t nonce,
+                               size_t length);
+
+/*
+* same as feistel_ctr_decrypt_buf but splits the input across the pool, the output is identical
+*/
+size_t feistel_ctr_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, uint8_t **keys, uint32_t nonce,
+                               size_t length);
+
+/*
+* same as feistel_ctr_crypt_at but splits the range across the pool, the output is identical
+*/
+size_t feistel_ctr_crypt_at_par(crypto_pool *pool, uint8_t *in, uint8_t *out, uint8_t **keys, uint32_t nonce,
+                                uint64_t offset, size_t length);
+
+/*
+* same as playfair_encrypt_buf but splits the input across the pool, the output is identical.
+* out must not overlap plaintext to run in parallel, otherwise it runs on the calling thread
+*/
+size_t playfair_encrypt_par(crypto_pool *pool, uint8_t *plaintext, uint8_t *out, const playfair_key *key, size_t length);
+
+/*
+* same as playfair_decrypt_buf but splits the digrams across the pool, the output is identical
+*/
+size_t playfair_decrypt_par(crypto_pool *pool, uint8_t *ciphertext, uint8_t *out, const playfair_key *key, size_t length);
+
+#define KEYSEARCH_CAESAR_KEYS   62      // distinct caesar keys, N modulo the alphabet
+#define KEYSEARCH_AFFINE_KEYS   312     // affine keys (a, b) with a coprime with 26
+
+/*
+* candidate key of a keysearch. the ciphertext is counted once into a byte histogram and every key scores the
+* histogram permuted through its decryption table against english letter frequencies, so the search costs one pass
+* over the input plus a few hundred table lookups per key instead of one decryption per key
+*/
+typedef struct keysearch_hit {
+    int key;            // caesar N, or the affine multiplier a
+    int inc;            // affine increment b, 0 for caesar
+    double score;       // mean log-likelihood per letter of the decryption, higher is more likely, -INFINITY when
+                        // the ciphertext has no byte the model scores
+} keysearch_hit;
+
+/*
+* tries every caesar key on length bytes of ciphertext and stores the count most likely ones into hits, best first.
+* returns the number of hits stored
+*/
+size_t caesar_keysearch(uint8_t *ciphertext, keysearch_hit *hits, size_t count, size_t length);
+
+/*
+* tries every affine key (a, b) on length bytes of ciphertext and stores the count most likely ones into hits,
+* best first. returns the number of hits stored
+*/
+size_t affine_keysearch(uint8_t *ciphertext, keysearch_hit *hits, size_t count, size_t length);
+
+/*
+* same as caesar_keysearch but builds the histogram across the pool
+*/
+size_t caesar_keysearch_par(crypto_pool *pool, uint8_t *ciphertext, keysearch_hit *hits, size_t count, size_t length);
+
+/*
+* same as affine_keysearch but builds the histogram across the pool
+*/
+size_t affine_keysearch_par(crypto_pool *pool, uint8_t *ciphertext, keysearch_hit *hits, size_t count, size_t length);
+
+#define QUADGRAM_COUNT          (26 * 26 * 26 * 26)
+#define PLAYFAIR_SOLVE_TRIALS   10000   // default candidate keys per temperature of an annealing chain
+#define PLAYFAIR_SOLVE_ROUNDS   100     // default temperatures an annealing chain cools down through
+
+/*
+* english language model of the playfair solver: the log10 probability of every run of 4 letters A-Z, I counted as J
+*/
+typedef struct quadgram_model {
+    float *score;       // QUADGRAM_COUNT entries, index ((a * 26 + b) * 26 + c) * 26 + d for letters counted from A
+} quadgram_model;
+
+/*
+* builds a quadgram model from length bytes of english text, case and everything but letters ignored.
+* returns 0, or -1 if out of memory or the text has no 4 letter run
+*/
+int quadgram_model_train(quadgram_model *model, uint8_t *text, size_t length);
+
+/*
+* builds a quadgram model from the file at path: "ABCD count" lines as published with the usual quadgram statistics,
+* or any other file taken as english text to count. returns 0, or -1 if it could not be read or had nothing to count
+*/
+int quadgram_model_load(quadgram_model *model, const char *path);
+
+/*
+* frees the table of a model made by quadgram_model_train or quadgram_model_load
+*/
+void quadgram_model_free(quadgram_model *model);
+
+/*
+* settings of playfair_solve, zero picks the default of every field
+*/
+typedef struct playfair_solve_params {
+    int chains;             // independent annealing chains, 0 runs one per pool participant
+    int trials;             // candidate keys per temperature, PLAYFAIR_SOLVE_TRIALS if 0
+    double temperature;     // starting temperature, scaled with the ciphertext length if 0
+    int rounds;             // temperatures from the starting one down to 0, PLAYFAIR_SOLVE_ROUNDS if 0
+    uint64_t seed;          // chain i draws its moves from a generator seeded with seed and i
+} playfair_solve_params;
+
+typedef struct playfair_solve_result {
+    playfair_key key;       // best key of all chains, tables set
+    double score;           // mean log10 quadgram probability of its decryption
+    uint64_t keys;          // candidate keys tried over all chains
+    double seconds;         // wall time of the search
+} playfair_solve_result;
+
+/*
+* recovers the playfair key of length bytes of ciphertext by simulated annealing over the 5x5 grid, scoring every
+* candidate's decryption with model. params->chains independent chains run across the pool (NULL runs them on the
+* calling thread), the best key of all of them is stored in result with tables set. returns 0, or -1 if the
+* ciphertext has fewer than 4 letters or memory ran out
+*/
+int playfair_solve(crypto_pool *pool, uint8_t *ciphertext, const quadgram_model *model,
+                   const playfair_solve_params *params, playfair_solve_result *result, size_t length);
+
+#define CRYPTO_ARENA_BLOCK  (64 << 10)  // default bytes an arena grows by
+#define CRYPTO_ARENA_CLASSES 9          // size classes of an arena, 16 to 4096 bytes
+
+/*
+* bump allocator the library can draw its results and scratch memory from instead of malloc. made current on a thread
+* with crypto_arena_use, the malloc returning functions (caesar_encrypt, playfair_keymatrix, random_key_create...)
+* allocate from it and their results must not be passed to free, crypto_arena_reset releases all of them at once.
+* an arena is used by one thread at a time
+*/
+typedef struct crypto_arena crypto_arena;
+
+/*
+* creates an arena growing block_size bytes at a time, 0 uses CRYPTO_ARENA_BLOCK. returns NULL if out of memory
+*/
+crypto_arena *crypto_arena_create(size_t block_size);
+
+/*
+* frees the arena and everything allocated from it, it stops being current on the calling thread
+*/
+void crypto_arena_destroy(crypto_arena *arena);
+
+/*
+* releases everything allocated from the arena at once, keeping its blocks for the next round of allocations
+*/
+void crypto_arena_reset(crypto_arena *arena);
+
+/*
+* returns size bytes aligned like malloc, valid until the next reset. small sizes are rounded up to their size class
+* and reuse what crypto_arena_free gave back, returns NULL if out of memory
+*/
+void *crypto_arena_alloc(crypto_arena *arena, size_t size);
+
+/*
+* gives size bytes allocated with crypto_arena_alloc back to their size class so the next allocation of the class
+* reuses them, bigger allocations stay until the reset
+*/
+void crypto_arena_free(crypto_arena *arena, void *data, size_t size);
+
+/*
+* makes arena the one the library allocates its results and scratch memory from on the calling thread (NULL goes
+* back to malloc), returns the arena that was current before
+*/
+crypto_arena *crypto_arena_use(crypto_arena *arena);
+
+/*
+* returns the calling thread's current arena, NULL if the library allocates with malloc
+*/
+crypto_arena *crypto_arena_current(void);
+
+#define CRYPTO_STATS_CAESAR     0
+#define CRYPTO_STATS_AFFINE     1
+#define CRYPTO_STATS_OTP        2
+#define CRYPTO_STATS_FEISTEL    3
+#define CRYPTO_STATS_PLAYFAIR   4
+#define CRYPTO_STATS_KEYGEN     5       // random_key_create and random_key_fill
+#define CRYPTO_STATS_CIPHERS    6
+
+#define CRYPTO_PHASE_KEY        0       // key setup: grids, tables, schedules and the feistel round keys
+#define CRYPTO_PHASE_PREPROCESS 1       // filtering, copying and padding ahead of the cipher
+#define CRYPTO_PHASE_TRANSFORM  2       // the cipher itself
+#define CRYPTO_PHASES           3
+
+/*
+* counters of one cipher. a call is one *_buf, *_par, *_mt or *_ctx_update call (the malloc returning functions go
+* through their *_buf), allocations are the results and key matrices the library allocates for the caller.
+* everything stays zero unless the library is built with CRYPTO_STATS (make STATS=1)
+*/
+typedef struct crypto_stats {
+    uint64_t calls;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+    uint64_t ns[CRYPTO_PHASES];         // wall time per CRYPTO_PHASE_*
+} crypto_stats;
+
+/*
+* returns 1 if the library was built with CRYPTO_STATS and counts, 0 if every counter stays zero
+*/
+int crypto_stats_enabled(void);
+
+/*
+* stores the counters of cipher (one of CRYPTO_STATS_*) added up over every thread since the last reset
+*/
+void crypto_stats_get(int cipher, crypto_stats *stats);
+
+/*
+* starts every counter of every cipher over from zero
+*/
+void crypto_stats_reset(void);
+
+/*
+* returns the name of cipher (one of CRYPTO_STATS_*)
+*/
+const char *crypto_stats_name(int cipher);
+
+#endif
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/random.h>
+#include "crypto.h"
+
+#define ROTL32(V, N)        (((V) << (N)) | ((V) >> (32 - (N))))
+
+#define QUARTER_ROUND(A, B, C, D) \
+    A += B; D ^= A; D = ROTL32(D, 16); \
+    C += D; B ^= C; B = ROTL32(B, 12); \
+    A += B; D ^= A; D = ROTL32(D, 8); \
+    C += D; B ^= C; B = ROTL32(B, 7);
+
+// generator used by random_key_create and random_key_fill, one per thread so keys never need a lock
+static __thread drbg_ctx default_drbg;
+static __thread int default_drbg_ready;
+
+/*
+* writes a 32 bit word in little endian order, the byte order chacha20 defines its output in
+*/
+static void store32_le(uint8_t *p, uint32_t v){
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+
+    return;
+}
+
+/*
+* reads a 32 bit little endian word
+*/
+static uint32_t load32_le(const uint8_t *p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*
+* the chacha20 block function, 64 bytes of keystream for the current key and block counter
+*/
+static void chacha20_block(const uint32_t *key, uint64_t counter, uint8_t *out){
+    uint32_t state[16], x[16];
+    int i;
+
+    // "expand 32-byte k"
+    state[0] = 0x61707865;
+    state[1] = 0x3320646e;
+    state[2] = 0x79622d32;
+    state[3] = 0x6b206574;
+    for(i = 0; i < 8; i++)
+        state[4 + i] = key[i];
+    state[12] = (uint32_t)counter;
+    state[13] = (uint32_t)(counter >> 32);
+    state[14] = 0;
+    state[15] = 0;
+
+    memcpy(x, state, sizeof(x));
+
+    // 10 double rounds, columns then diagonals
+    for(i = 0; i < 10; i++){
+        QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+        QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+        QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+        QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+        QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+        QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+        QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+        QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+    }
+
+    for(i = 0; i < 16; i++)
+        store32_le(out + (i * 4), x[i] + state[i]);
+
+    return;
+}
+
+/*
+* refills the whole batch buffer, the first 32 bytes of every batch replace the key and are never handed out
+* so earlier output can not be recomputed from the state (fast key erasure)
+*/
+static void drbg_refill(drbg_ctx *ctx){
+    long i;
+    int k;
+
+    for(i = 0; i < DRBG_BUFFER_SIZE; i += 64)
+        chacha20_block(ctx->key, ctx->counter++, ctx->buffer + i);
+
+    for(k = 0; k < 8; k++)
+        ctx->key[k] = load32_le(ctx->buffer + (k * 4));
+    memset(ctx->buffer, 0, 32);
+
+    ctx->available = DRBG_BUFFER_SIZE - 32;
+
+    return;
+}
+
+/*
+* reads size bytes of seed material from the kernel, getrandom first and /dev/urandom where it is missing
+*/
+static int drbg_os_seed(uint8_t *seed, long size){
+    long got, n;
+    int fd;
+
+    for(got = 0; got < size; got += n){
+        n = getrandom(seed + got, size - got, 0);
+        if(n < 0){
+            if(errno == EINTR){
+                n = 0;
+                continue;
+            }
+            break;
+        }
+    }
+    if(got == size)
+        return 0;
+
+    fd = open("/dev/urandom", O_RDONLY);
+    if(fd < 0)
+        return -1;
+    for(got = 0; got < size; got += n){
+        n = read(fd, seed + got, size - got);
+        if(n <= 0)
+            break;
+    }
+    close(fd);
+
+    return got == size ? 0 : -1;
+}
+
+/*
+* seeds the generator once from the kernel, returns 0 on success and -1 if no seed could be read
+*/
+int drbg_init(drbg_ctx *ctx){
+    uint8_t seed[32];
+    int k;
+
+    memset(ctx, 0, sizeof(*ctx));
+    if(drbg_os_seed(seed, sizeof(seed)) < 0)
+        return -1;
+
+    for(k = 0; k < 8; k++)
+        ctx->key[k] = load32_le(seed + (k * 4));
+    memset(seed, 0, sizeof(seed));
+
+    ctx->pid = getpid();
+
+    return 0;
+}
+
+/*
+* seeds the generator from the kernel for key creation, aborting when no seed can be read since every key made from
+* an unseeded generator would be predictable
+*/
+static void drbg_reseed(drbg_ctx *ctx){
+    if(drbg_init(ctx) < 0){
+        fprintf(stderr, "error: could not seed the key generator\n");
+        abort();
+    }
+
+    return;
+}
+
+/*
+* seeds the generator from a fixed value so the same stream is produced on every run, meant for benchmarks and tests
+*/
+void drbg_init_seeded(drbg_ctx *ctx, uint64_t seed){
+    memset(ctx, 0, sizeof(*ctx));
+
+    ctx->key[0] = (uint32_t)seed;
+    ctx->key[1] = (uint32_t)(seed >> 32);
+    ctx->seeded = 1;
+
+    return;
+}
+
+/*
+* copies size bytes of key material into out, refilling the batch buffer whenever it runs dry. a generator seeded
+* from the kernel reseeds in a forked child before handing out anything
+*/
+void drbg_generate(drbg_ctx *ctx, uint8_t *out, size_t size){
+    size_t n;
+
+    // a forked child must not replay its parent's stream, not even the bytes still buffered
+    if(!ctx->seeded && ctx->pid != getpid())
+        drbg_reseed(ctx);
+
+    while(size > 0){
+        if(ctx->available == 0)
+            drbg_refill(ctx);
+
+        n = size < ctx->available ? size : ctx->available;
+
+        // unread bytes are always the tail of the buffer
+        memcpy(out, ctx->buffer + DRBG_BUFFER_SIZE - ctx->available, n);
+        memset(ctx->buffer + DRBG_BUFFER_SIZE - ctx->available, 0, n);
+
+        ctx->available -= n;
+        out += n;
+        size -= n;
+    }
+
+    return;
+}
+
+/*
+* returns the calling thread's generator used for key creation, seeding it on first use and aborting if it can not
+* be seeded
+*/
+drbg_ctx *drbg_default(void){
+    if(!default_drbg_ready){
+        drbg_reseed(&default_drbg);
+        default_drbg_ready = 1;
+    }
+
+    return &default_drbg;
+}
+
+/*
+* switches the calling thread's key generator to the reproducible stream of the given seed
+*/
+void random_key_seed(uint64_t seed){
+    drbg_init_seeded(&default_drbg, seed);
+    default_drbg_ready = 1;
+
+    return;
+}
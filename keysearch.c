@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "crypto.h"
+#include "pool.h"
+
+#define KEYSEARCH_BANKS     4           // histogram copies counted in turn so repeated bytes do not wait on each other
+#define KEYSEARCH_LOWER     0.75        // share of letters expected lower case by the caesar model
+#define KEYSEARCH_UPPER     0.23        // share expected upper case, the rest goes to the digits
+
+// relative frequency of a to z in english text
+static const double keysearch_english[26] = {
+    0.08167, 0.01492, 0.02782, 0.04253, 0.12702, 0.02228, 0.02015, 0.06094, 0.06966, 0.00153, 0.00772, 0.04025, 0.02406,
+    0.06749, 0.07507, 0.01929, 0.00095, 0.05987, 0.06327, 0.09056, 0.02758, 0.00978, 0.02360, 0.00150, 0.01974, 0.00074
+};
+
+// log probability of every plaintext byte: caesar over its 62 symbols, affine over A-Z only
+static double caesar_model[256];
+static double affine_model[256];
+static pthread_once_t keysearch_once = PTHREAD_ONCE_INIT;
+
+// histogram of one ciphertext, chunks add their counts in when done
+struct keysearch_job {
+    const uint8_t *in;
+    size_t size;
+    uint64_t counts[256];
+};
+
+/*
+* pthread_once body building both language models
+*/
+static void keysearch_model_init(void){
+    int i;
+
+    for(i = 0; i < 26; i++){
+        caesar_model['a' + i] = log(KEYSEARCH_LOWER * keysearch_english[i]);
+        caesar_model['A' + i] = log(KEYSEARCH_UPPER * keysearch_english[i]);
+        affine_model['A' + i] = log(keysearch_english[i]);
+    }
+    for(i = 0; i < 10; i++)
+        caesar_model['0' + i] = log((1.0 - KEYSEARCH_LOWER - KEYSEARCH_UPPER) / 10);
+
+    return;
+}
+
+/*
+* counts every byte of chunk into the job's histogram, in banks of 32 bit counters that a chunk cannot overflow
+*/
+static void keysearch_count(void *arg, size_t chunk){
+    struct keysearch_job *job = (struct keysearch_job*)arg;
+    uint32_t banks[KEYSEARCH_BANKS][256];
+    const uint8_t *in;
+    size_t start, size, i;
+    int c;
+
+    start = chunk * CRYPTO_PAR_CHUNK;
+    size = job->size - start < CRYPTO_PAR_CHUNK ? job->size - start : CRYPTO_PAR_CHUNK;
+    in = job->in + start;
+
+    memset(banks, 0, sizeof(banks));
+    for(i = 0; i + KEYSEARCH_BANKS <= size; i += KEYSEARCH_BANKS){
+        banks[0][in[i]]++;
+        banks[1][in[i + 1]]++;
+        banks[2][in[i + 2]]++;
+        banks[3][in[i + 3]]++;
+    }
+    for(; i < size; i++)
+        banks[0][in[i]]++;
+
+    for(c = 0; c < 256; c++){
+        size = (size_t)banks[0][c] + banks[1][c] + banks[2][c] + banks[3][c];
+        if(size != 0)
+            __atomic_fetch_add(&job->counts[c], size, __ATOMIC_RELAXED);
+    }
+
+    return;
+}
+
+/*
+* builds the histogram of length bytes of in, across the pool once the input is past its threshold
+*/
+static void keysearch_histogram(crypto_pool *pool, const uint8_t *in, size_t length, uint64_t *counts){
+    struct keysearch_job job;
+    size_t chunks, chunk;
+
+    job.in = in;
+    job.size = length;
+    memset(job.counts, 0, sizeof(job.counts));
+
+    chunks = (length + CRYPTO_PAR_CHUNK - 1) / CRYPTO_PAR_CHUNK;
+    if(pool == NULL || length < crypto_pool_threshold(pool) || crypto_pool_threads(pool) <= 1){
+        for(chunk = 0; chunk < chunks; chunk++)
+            keysearch_count(&job, chunk);
+    }else{
+        pool_run(pool, chunks, keysearch_count, &job);
+    }
+    memcpy(counts, job.counts, sizeof(job.counts));
+
+    return;
+}
+
+/*
+* mean log-likelihood under model of the text the histogram decrypts to through dec, counting only the bytes the
+* model scores. the histogram is permuted instead of the ciphertext decrypted. -INFINITY if no byte can be scored, a
+* real log-likelihood is always negative so 0 would outrank every genuine key
+*/
+static double keysearch_score(const uint64_t *counts, const uint8_t *dec, const double *model){
+    double score = 0;
+    uint64_t total = 0;
+    int c;
+
+    for(c = 0; c < 256; c++){
+        if(counts[c] == 0 || model[dec[c]] == 0)
+            continue;
+        score += counts[c] * model[dec[c]];
+        total += counts[c];
+    }
+
+    return total ? score / total : -INFINITY;
+}
+
+/*
+* best score first, ties in key order so the ranking does not depend on qsort
+*/
+static int keysearch_compare(const void *a, const void *b){
+    const keysearch_hit *x = (const keysearch_hit*)a, *y = (const keysearch_hit*)b;
+
+    if(x->score != y->score)
+        return x->score < y->score ? 1 : -1;
+    if(x->key != y->key)
+        return x->key - y->key;
+
+    return x->inc - y->inc;
+}
+
+/*
+* sorts the n scored candidates and copies the best count of them into hits, returns how many were copied
+*/
+static size_t keysearch_rank(keysearch_hit *candidates, size_t n, keysearch_hit *hits, size_t count){
+    qsort(candidates, n, sizeof(keysearch_hit), keysearch_compare);
+    if(count > n)
+        count = n;
+    memcpy(hits, candidates, count * sizeof(keysearch_hit));
+
+    return count;
+}
+
+/*
+* same as caesar_keysearch but builds the histogram across the pool
+*/
+size_t caesar_keysearch_par(crypto_pool *pool, uint8_t *ciphertext, keysearch_hit *hits, size_t count, size_t length){
+    keysearch_hit candidates[KEYSEARCH_CAESAR_KEYS];
+    uint64_t counts[256];
+    subst_table table;
+    int N;
+
+    pthread_once(&keysearch_once, keysearch_model_init);
+    keysearch_histogram(pool, ciphertext, length, counts);
+
+    for(N = 0; N < KEYSEARCH_CAESAR_KEYS; N++){
+        caesar_table_init(&table, N);
+        candidates[N].key = N;
+        candidates[N].inc = 0;
+        candidates[N].score = keysearch_score(counts, table.dec, caesar_model);
+    }
+
+    return keysearch_rank(candidates, KEYSEARCH_CAESAR_KEYS, hits, count);
+}
+
+/*
+* same as affine_keysearch but builds the histogram across the pool
+*/
+size_t affine_keysearch_par(crypto_pool *pool, uint8_t *ciphertext, keysearch_hit *hits, size_t count, size_t length){
+    keysearch_hit candidates[KEYSEARCH_AFFINE_KEYS];
+    uint64_t counts[256];
+    affine_key key;
+    size_t n = 0;
+    int a, b;
+
+    pthread_once(&keysearch_once, keysearch_model_init);
+    keysearch_histogram(pool, ciphertext, length, counts);
+
+    for(a = 1; a < 26; a++){
+        for(b = 0; b < 26; b++){
+            if(affine_key_init(&key, a, b) != 0)
+                break;
+            candidates[n].key = a;
+            candidates[n].inc = b;
+            candidates[n].score = keysearch_score(counts, key.table.dec, affine_model);
+            n++;
+        }
+    }
+
+    return keysearch_rank(candidates, n, hits, count);
+}
+
+/*
+* tries every caesar key on length bytes of ciphertext and stores the count most likely ones into hits, best first.
+* returns the number of hits stored
+*/
+size_t caesar_keysearch(uint8_t *ciphertext, keysearch_hit *hits, size_t count, size_t length){
+    return caesar_keysearch_par(NULL, ciphertext, hits, count, length);
+}
+
+/*
+* tries every affine key (a, b) on length bytes of ciphertext and stores the count most likely ones into hits,
+* best first. returns the number of hits stored
+*/
+size_t affine_keysearch(uint8_t *ciphertext, keysearch_hit *hits, size_t count, size_t length){
+    return affine_keysearch_par(NULL, ciphertext, hits, count, length);
+}
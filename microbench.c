@@ -0,0 +1,358 @@
+/*
+* microbenchmarks of the hot helpers inside crypto.c, which is included whole so its static functions can be called
+* directly. build with make microbench
+*/
+#include "crypto.c"
+#include <time.h>
+#include <math.h>
+
+#define MICRO_WARMUP        32          // samples run and thrown away before measuring
+#define MICRO_SAMPLES       301         // default measured samples per kernel
+#define MICRO_SAMPLE_NS     20000       // calls are batched until one sample takes at least this long
+#define MICRO_TEXT_SIZE     4096        // input of the buffer kernels
+#define MICRO_DIGRAMS       256         // digrams cycled through by the match kernels
+#define MICRO_IQR_FENCE     1.5         // samples further than this many IQRs outside the quartiles are outliers
+
+// runs calls calls of one kernel
+typedef void (*micro_fn)(size_t calls);
+
+typedef struct micro_kernel {
+    const char *name;
+    micro_fn run;
+    size_t bytes;       // bytes one call works on, 0 for the per element kernels
+} micro_kernel;
+
+// keeps a value alive without the compiler knowing what happens to it
+#define MICRO_KEEP(V)       __asm__ volatile("" : : "r"(V) : "memory")
+
+static uint8_t micro_text[MICRO_TEXT_SIZE];
+static uint8_t micro_out[FEISTEL_PADDED_SIZE(MICRO_TEXT_SIZE) + 2];
+static uint8_t micro_digrams[MICRO_DIGRAMS][2];
+static playfair_key micro_pk_index, micro_pk_tables;
+static uint32_t micro_schedule[FEISTEL_ROUNDS];
+
+/*
+* monotonic time in nanoseconds
+*/
+static uint64_t micro_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void micro_feistel_round(size_t calls){
+    uint32_t half = 0x01234567;
+    size_t i;
+
+    // chained so every call waits on the one before, latency rather than throughput
+    for(i = 0; i < calls; i++)
+        half = feistel_round(half, micro_schedule[i % FEISTEL_ROUNDS]);
+    MICRO_KEEP(half);
+
+    return;
+}
+
+static void micro_feistel_flip(size_t calls){
+    uint32_t left = 1, right = 2;
+    size_t i;
+
+    for(i = 0; i < calls; i++){
+        feistel_flip(&left, &right);
+        MICRO_KEEP(left);
+    }
+    MICRO_KEEP(right);
+
+    return;
+}
+
+static void micro_feistel_blocks(size_t calls){
+    size_t i;
+
+    for(i = 0; i < calls; i++){
+        feistel_blocks(micro_out, MICRO_TEXT_SIZE / FEISTEL_BLOCK_SIZE, micro_schedule, 0);
+        MICRO_KEEP(micro_out);
+    }
+
+    return;
+}
+
+static void micro_playfair_encrypt_match(size_t calls){
+    uint8_t out[2];
+    size_t i;
+
+    for(i = 0; i < calls; i++){
+        playfair_encrypt_match(&micro_pk_index, micro_digrams[i % MICRO_DIGRAMS], out);
+        MICRO_KEEP(out);
+    }
+
+    return;
+}
+
+static void micro_playfair_decrypt_match(size_t calls){
+    uint8_t out[2];
+    size_t i;
+
+    for(i = 0; i < calls; i++){
+        playfair_decrypt_match(&micro_pk_index, micro_digrams[i % MICRO_DIGRAMS], out);
+        MICRO_KEEP(out);
+    }
+
+    return;
+}
+
+static void micro_playfair_encrypt_match_tables(size_t calls){
+    uint8_t out[2];
+    size_t i;
+
+    for(i = 0; i < calls; i++){
+        playfair_encrypt_match(&micro_pk_tables, micro_digrams[i % MICRO_DIGRAMS], out);
+        MICRO_KEEP(out);
+    }
+
+    return;
+}
+
+static void micro_playfair_decrypt_match_tables(size_t calls){
+    uint8_t out[2];
+    size_t i;
+
+    for(i = 0; i < calls; i++){
+        playfair_decrypt_match(&micro_pk_tables, micro_digrams[i % MICRO_DIGRAMS], out);
+        MICRO_KEEP(out);
+    }
+
+    return;
+}
+
+static void micro_playfair_encrypt_scan(size_t calls){
+    size_t i;
+    int pending;
+
+    for(i = 0; i < calls; i++){
+        pending = -1;
+        MICRO_KEEP(playfair_encrypt_scan(&micro_pk_tables, micro_text, micro_out, MICRO_TEXT_SIZE, &pending));
+    }
+
+    return;
+}
+
+static void micro_otp_preprocess(size_t calls){
+    size_t i;
+
+    for(i = 0; i < calls; i++){
+        otp_preprocess(micro_text, micro_out, MICRO_TEXT_SIZE);
+        MICRO_KEEP(micro_out);
+    }
+
+    return;
+}
+
+static void micro_preprocess_plaintext(size_t calls){
+    size_t i;
+
+    for(i = 0; i < calls; i++)
+        MICRO_KEEP(preprocess_plaintext(micro_text, micro_out, MICRO_TEXT_SIZE));
+
+    return;
+}
+
+static void micro_random_key_create(size_t calls){
+    uint8_t *key;
+    size_t i;
+
+    for(i = 0; i < calls; i++){
+        key = random_key_create(FEISTEL_BLOCK_SIZE / 2);
+        MICRO_KEEP(key);
+        free(key);
+    }
+
+    return;
+}
+
+static void micro_random_key_fill(size_t calls){
+    uint8_t key[FEISTEL_BLOCK_SIZE / 2];
+    size_t i;
+
+    for(i = 0; i < calls; i++){
+        random_key_fill(key, sizeof(key));
+        MICRO_KEEP(key);
+    }
+
+    return;
+}
+
+static const micro_kernel kernels[] = {
+    {"feistel_round", micro_feistel_round, 0},
+    {"feistel_flip", micro_feistel_flip, 0},
+    {"feistel_blocks", micro_feistel_blocks, MICRO_TEXT_SIZE},
+    {"playfair_encrypt_match", micro_playfair_encrypt_match, 0},
+    {"playfair_decrypt_match", micro_playfair_decrypt_match, 0},
+    {"playfair_encrypt_match/tables", micro_playfair_encrypt_match_tables, 0},
+    {"playfair_decrypt_match/tables", micro_playfair_decrypt_match_tables, 0},
+    {"playfair_encrypt_scan", micro_playfair_encrypt_scan, MICRO_TEXT_SIZE},
+    {"otp_preprocess", micro_otp_preprocess, MICRO_TEXT_SIZE},
+    {"preprocess_plaintext", micro_preprocess_plaintext, MICRO_TEXT_SIZE},
+    {"random_key_create", micro_random_key_create, 0},
+    {"random_key_fill", micro_random_key_fill, 0},
+};
+
+static int micro_compare(const void *a, const void *b){
+    double x = *(const double*)a, y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+* value at fraction q of sorted samples, interpolating between neighbours
+*/
+static double micro_percentile(const double *sorted, size_t count, double q){
+    double position, fraction;
+    size_t low;
+
+    position = q * (count - 1);
+    low = (size_t)position;
+    fraction = position - low;
+    if(low + 1 >= count)
+        return sorted[count - 1];
+
+    return sorted[low] + (sorted[low + 1] - sorted[low]) * fraction;
+}
+
+/*
+* doubles the batch until one sample of the kernel takes MICRO_SAMPLE_NS, so clock resolution stays out of the result
+*/
+static size_t micro_calibrate(micro_fn run){
+    uint64_t start;
+    size_t batch;
+
+    for(batch = 1; batch < ((size_t)1 << 30); batch *= 2){
+        start = micro_ns();
+        run(batch);
+        if(micro_ns() - start >= MICRO_SAMPLE_NS)
+            break;
+    }
+
+    return batch;
+}
+
+/*
+* measures one kernel: warmup, samples of ns per call, tukey fence outlier rejection and the statistics of what is left
+*/
+static void micro_measure(const micro_kernel *k, size_t samples, int csv){
+    double *ns, *kept, q1, q3, low, high, mean, var;
+    size_t batch, i, count;
+    uint64_t start;
+
+    ns = (double*)malloc(samples * sizeof(double));
+    kept = (double*)malloc(samples * sizeof(double));
+
+    batch = micro_calibrate(k->run);
+    for(i = 0; i < MICRO_WARMUP; i++)
+        k->run(batch);
+
+    for(i = 0; i < samples; i++){
+        start = micro_ns();
+        k->run(batch);
+        ns[i] = (double)(micro_ns() - start) / batch;
+    }
+
+    qsort(ns, samples, sizeof(double), micro_compare);
+    q1 = micro_percentile(ns, samples, 0.25);
+    q3 = micro_percentile(ns, samples, 0.75);
+    low = q1 - MICRO_IQR_FENCE * (q3 - q1);
+    high = q3 + MICRO_IQR_FENCE * (q3 - q1);
+
+    // sorted stays sorted after dropping both ends
+    for(i = 0, count = 0, mean = 0; i < samples; i++){
+        if(ns[i] >= low && ns[i] <= high){
+            kept[count++] = ns[i];
+            mean += ns[i];
+        }
+    }
+    mean /= count;
+    for(i = 0, var = 0; i < count; i++)
+        var += (kept[i] - mean) * (kept[i] - mean);
+    var = count > 1 ? var / (count - 1) : 0;
+
+    if(csv){
+        printf("%s,%zu,%zu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", k->name, batch, count, samples - count, kept[0],
+               micro_percentile(kept, count, 0.5), micro_percentile(kept, count, 0.9),
+               micro_percentile(kept, count, 0.99), mean, sqrt(var),
+               k->bytes ? micro_percentile(kept, count, 0.5) / k->bytes : 0.0);
+    }else{
+        printf("%-30s %9zu %5zu %4zu %11.3f %11.3f %11.3f %11.3f %9.3f", k->name, batch, count, samples - count, kept[0],
+               micro_percentile(kept, count, 0.5), micro_percentile(kept, count, 0.9),
+               micro_percentile(kept, count, 0.99), sqrt(var));
+        if(k->bytes)
+            printf("  %.4f ns/B", micro_percentile(kept, count, 0.5) / k->bytes);
+        printf("\n");
+    }
+
+    free(ns);
+    free(kept);
+
+    return;
+}
+
+int main(int argc, char **argv){
+    size_t samples, i;
+    const char *only;
+    uint8_t *keys[FEISTEL_ROUNDS], key_bytes[FEISTEL_ROUNDS][FEISTEL_BLOCK_SIZE / 2];
+    int csv;
+
+    samples = MICRO_SAMPLES;
+    only = NULL;
+    csv = 0;
+
+    for(i = 1; i < (size_t)argc; i++){
+        if(strcmp("-csv", argv[i]) == 0){
+            csv = 1;
+        }else if(strcmp("-samples", argv[i]) == 0 && i + 1 < (size_t)argc){
+            samples = strtoul(argv[++i], NULL, 10);
+        }else if(strcmp("-kernel", argv[i]) == 0 && i + 1 < (size_t)argc){
+            only = argv[++i];
+        }else{
+            printf("usage: ./microbench [-csv] [-samples N] [-kernel NAME]\n");
+            exit(0);
+        }
+    }
+    if(samples < 4)
+        samples = 4;
+
+    // same inputs on every run: text of letters, spaces and punctuation, random digrams and round keys
+    random_key_seed(1);
+    random_key_fill(micro_text, sizeof(micro_text));
+    for(i = 0; i < sizeof(micro_text); i++)
+        micro_text[i] = (micro_text[i] % 8 == 0) ? " .,"[micro_text[i] % 3] : 'A' + (micro_text[i] % 26);
+    for(i = 0; i < MICRO_DIGRAMS; i++){
+        random_key_fill(micro_digrams[i], 2);
+        micro_digrams[i][0] = 'A' + (micro_digrams[i][0] % 26);
+        micro_digrams[i][1] = 'A' + (micro_digrams[i][1] % 26);
+    }
+    playfair_key_init(&micro_pk_index, (uint8_t*)"MONARCHY", 0);
+    playfair_key_init(&micro_pk_tables, (uint8_t*)"MONARCHY", 1);
+    for(i = 0; i < FEISTEL_ROUNDS; i++){
+        keys[i] = key_bytes[i];
+        random_key_fill(keys[i], FEISTEL_BLOCK_SIZE / 2);
+    }
+    feistel_schedule(keys, micro_schedule);
+    memcpy(micro_out, micro_text, sizeof(micro_text));
+
+    if(csv){
+        printf("kernel,batch,kept,outliers,min_ns,median_ns,p90_ns,p99_ns,mean_ns,stddev_ns,median_ns_byte\n");
+    }else{
+        printf("latency per call in ns over %zu samples, simd kernels: %s\n", samples, crypto_simd_name());
+        printf("%-30s %9s %5s %4s %11s %11s %11s %11s %9s\n", "kernel", "batch", "kept", "out", "min", "median", "p90",
+               "p99", "stddev");
+    }
+
+    for(i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++){
+        if(only && strcmp(only, kernels[i].name) != 0)
+            continue;
+        micro_measure(&kernels[i], samples, csv);
+    }
+
+    return 0;
+}
@@ -0,0 +1,545 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "pipeline.h"
+
+enum { SLOT_FREE, SLOT_READING, SLOT_READY, SLOT_WRITING };
+enum { OP_READ, OP_WRITE };
+
+// one buffer of the pipeline and the single read or write it has in flight
+struct pipe_slot {
+    int state;
+    int op;
+    int fd;
+    size_t seq;                 // chunk index of the data it holds
+    uint8_t *in;
+    uint8_t *out;
+    size_t size;                // bytes the current read or write has to move
+    size_t done;                // bytes moved so far, short transfers are resubmitted for the rest
+    off_t offset;               // file offset of the first byte, -1 for the current position of a stream
+    struct iovec iov;
+    ssize_t res;                // result handed back by the thread backend
+    struct pipe_slot *next;     // thread backend queue link
+};
+
+// the rings of an io_uring instance, set up and driven with raw syscalls
+struct uring {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned pending;           // queued sqes the kernel has not taken yet
+};
+
+// pread/pwrite threads standing in for io_uring
+struct pipe_threads {
+    pthread_t tids[PIPELINE_DEPTH];
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    struct pipe_slot *queue;
+    struct pipe_slot *finished;
+    int quit;
+};
+
+struct pipe_io {
+    int uring;
+    struct uring ring;
+    struct pipe_threads threads;
+};
+
+/*
+* sets up an io_uring of entries slots and maps its rings, returns -1 if the kernel does not have it (or forbids it)
+*/
+static int uring_setup(struct uring *ring, unsigned entries){
+    struct io_uring_params p;
+    uint8_t *sq, *cq;
+
+    memset(&p, 0, sizeof(p));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if(ring->fd < 0)
+        return -1;
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    // newer kernels share one mapping for both rings
+    if(p.features & IORING_FEAT_SINGLE_MMAP){
+        if(ring->cq_ring_size > ring->sq_ring_size)
+            ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_SQ_RING);
+    if(ring->sq_ring == MAP_FAILED){
+        close(ring->fd);
+        return -1;
+    }
+
+    ring->cq_ring = ring->sq_ring;
+    if(!(p.features & IORING_FEAT_SINGLE_MMAP)){
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                             IORING_OFF_CQ_RING);
+        if(ring->cq_ring == MAP_FAILED){
+            munmap(ring->sq_ring, ring->sq_ring_size);
+            close(ring->fd);
+            return -1;
+        }
+    }
+
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED){
+        if(ring->cq_ring != ring->sq_ring)
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(ring->fd);
+        return -1;
+    }
+
+    sq = (uint8_t*)ring->sq_ring;
+    cq = (uint8_t*)ring->cq_ring;
+    ring->sq_head = (unsigned*)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + p.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    ring->pending = 0;
+
+    return 0;
+}
+
+static void uring_close(struct uring *ring){
+    munmap(ring->sqes, ring->sqes_size);
+    if(ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+
+    return;
+}
+
+/*
+* queues the slot's transfer as a readv/writev sqe, handed to the kernel on the next wait
+*/
+static void uring_submit(struct uring *ring, struct pipe_slot *slot){
+    struct io_uring_sqe *sqe;
+    unsigned tail, index;
+
+    tail = *ring->sq_tail;
+    index = tail & *ring->sq_mask;
+    sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (slot->op == OP_READ) ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd = slot->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&slot->iov;
+    sqe->len = 1;
+    sqe->off = (slot->offset < 0) ? (uint64_t)-1 : (uint64_t)(slot->offset + slot->done);
+    sqe->user_data = (uint64_t)(uintptr_t)slot;
+
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+
+    return;
+}
+
+/*
+* hands queued sqes to the kernel and returns the next finished slot with its result, NULL if io_uring_enter fails
+*/
+static struct pipe_slot *uring_wait(struct uring *ring, ssize_t *res){
+    struct io_uring_cqe *cqe;
+    struct pipe_slot *slot;
+    unsigned head, tail;
+    int ret;
+
+    for(;;){
+        head = *ring->cq_head;
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+        // submit first so the kernel works on the new transfers while we look at completions
+        if(ring->pending > 0 || head == tail){
+            ret = (int)syscall(__NR_io_uring_enter, ring->fd, ring->pending, head == tail ? 1 : 0,
+                               head == tail ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+            if(ret < 0){
+                if(errno == EINTR)
+                    continue;
+                return NULL;
+            }
+            ring->pending -= ret;
+            continue;
+        }
+
+        cqe = &ring->cqes[head & *ring->cq_mask];
+        slot = (struct pipe_slot*)(uintptr_t)cqe->user_data;
+        *res = cqe->res;
+        __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+        return slot;
+    }
+}
+
+/*
+* pread/pwrite thread, runs queued transfers and posts them as finished
+*/
+static void *pipe_thread_main(void *arg){
+    struct pipe_threads *threads = (struct pipe_threads*)arg;
+    struct pipe_slot *slot, **tail;
+    void *buf;
+    size_t len;
+    off_t offset;
+    ssize_t ret;
+
+    for(;;){
+        pthread_mutex_lock(&threads->lock);
+        while(threads->queue == NULL && !threads->quit)
+            pthread_cond_wait(&threads->work, &threads->lock);
+        if(threads->queue == NULL){
+            pthread_mutex_unlock(&threads->lock);
+            break;
+        }
+        slot = threads->queue;
+        threads->queue = slot->next;
+        pthread_mutex_unlock(&threads->lock);
+
+        buf = slot->iov.iov_base;
+        len = slot->iov.iov_len;
+        offset = slot->offset + slot->done;
+        do{
+            if(slot->op == OP_READ)
+                ret = (slot->offset < 0) ? read(slot->fd, buf, len) : pread(slot->fd, buf, len, offset);
+            else
+                ret = (slot->offset < 0) ? write(slot->fd, buf, len) : pwrite(slot->fd, buf, len, offset);
+        }while(ret < 0 && errno == EINTR);
+        slot->res = (ret < 0) ? -errno : ret;
+
+        pthread_mutex_lock(&threads->lock);
+        slot->next = NULL;
+        for(tail = &threads->finished; *tail != NULL; tail = &(*tail)->next);
+        *tail = slot;
+        pthread_cond_signal(&threads->done);
+        pthread_mutex_unlock(&threads->lock);
+    }
+
+    return NULL;
+}
+
+/*
+* starts the pread/pwrite threads, returns -1 if none could be started
+*/
+static int threads_setup(struct pipe_threads *threads){
+    memset(threads, 0, sizeof(*threads));
+    pthread_mutex_init(&threads->lock, NULL);
+    pthread_cond_init(&threads->work, NULL);
+    pthread_cond_init(&threads->done, NULL);
+
+    for(threads->count = 0; threads->count < PIPELINE_DEPTH; threads->count++){
+        if(pthread_create(&threads->tids[threads->count], NULL, pipe_thread_main, threads) != 0)
+            break;
+    }
+
+    return threads->count > 0 ? 0 : -1;
+}
+
+static void threads_close(struct pipe_threads *threads){
+    int t;
+
+    pthread_mutex_lock(&threads->lock);
+    threads->quit = 1;
+    pthread_cond_broadcast(&threads->work);
+    pthread_mutex_unlock(&threads->lock);
+
+    for(t = 0; t < threads->count; t++)
+        pthread_join(threads->tids[t], NULL);
+
+    pthread_mutex_destroy(&threads->lock);
+    pthread_cond_destroy(&threads->work);
+    pthread_cond_destroy(&threads->done);
+
+    return;
+}
+
+static void threads_submit(struct pipe_threads *threads, struct pipe_slot *slot){
+    struct pipe_slot **tail;
+
+    pthread_mutex_lock(&threads->lock);
+    slot->next = NULL;
+    for(tail = &threads->queue; *tail != NULL; tail = &(*tail)->next);
+    *tail = slot;
+    pthread_cond_signal(&threads->work);
+    pthread_mutex_unlock(&threads->lock);
+
+    return;
+}
+
+static struct pipe_slot *threads_wait(struct pipe_threads *threads, ssize_t *res){
+    struct pipe_slot *slot;
+
+    pthread_mutex_lock(&threads->lock);
+    while(threads->finished == NULL)
+        pthread_cond_wait(&threads->done, &threads->lock);
+    slot = threads->finished;
+    threads->finished = slot->next;
+    pthread_mutex_unlock(&threads->lock);
+    *res = slot->res;
+
+    return slot;
+}
+
+/*
+* true unless CRYPTO_PIPELINE=threads asks for the fallback
+*/
+static int pipe_want_uring(void){
+    const char *env = getenv("CRYPTO_PIPELINE");
+
+    return env == NULL || strcmp(env, "threads") != 0;
+}
+
+/*
+* opens the I/O backend, io_uring when possible and the threads otherwise
+*/
+static int pipe_io_open(struct pipe_io *io){
+    io->uring = pipe_want_uring() && uring_setup(&io->ring, PIPELINE_DEPTH * 2) == 0;
+    if(io->uring)
+        return 0;
+
+    return threads_setup(&io->threads);
+}
+
+static void pipe_io_close(struct pipe_io *io){
+    if(io->uring)
+        uring_close(&io->ring);
+    else
+        threads_close(&io->threads);
+
+    return;
+}
+
+/*
+* starts (or continues after a short transfer) the slot's read or write
+*/
+static void pipe_io_submit(struct pipe_io *io, struct pipe_slot *slot){
+    slot->iov.iov_base = ((slot->op == OP_READ) ? slot->in : slot->out) + slot->done;
+    slot->iov.iov_len = slot->size - slot->done;
+
+    if(io->uring)
+        uring_submit(&io->ring, slot);
+    else
+        threads_submit(&io->threads, slot);
+
+    return;
+}
+
+static struct pipe_slot *pipe_io_wait(struct pipe_io *io, ssize_t *res){
+    if(io->uring)
+        return uring_wait(&io->ring, res);
+
+    return threads_wait(&io->threads, res);
+}
+
+/*
+* returns the I/O backend pipeline_run uses: "io_uring" or "threads"
+*/
+const char *pipeline_backend(void){
+    struct uring ring;
+
+    if(pipe_want_uring() && uring_setup(&ring, PIPELINE_DEPTH * 2) == 0){
+        uring_close(&ring);
+        return "io_uring";
+    }
+
+    return "threads";
+}
+
+/*
+* writes all size bytes to fd at offset (or the current position for -1) without the backend, for the final bytes
+*/
+static int pipe_write_all(int fd, uint8_t *data, size_t size, off_t offset){
+    ssize_t put;
+
+    while(size > 0){
+        put = (offset < 0) ? write(fd, data, size) : pwrite(fd, data, size, offset);
+        if(put < 0 && errno == EINTR)
+            continue;
+        if(put <= 0)
+            return -1;
+        data += put;
+        size -= put;
+        if(offset >= 0)
+            offset += put;
+    }
+
+    return 0;
+}
+
+/*
+* streams the regular file infd through update/final into outfd, keeping PIPELINE_DEPTH chunks in flight so the
+* transform of one chunk overlaps the read of the next and the write of the previous ones.
+* returns the bytes written, or -1 on an I/O error
+*/
+long long pipeline_run(int infd, int outfd, pipeline_update_fn update, pipeline_final_fn final, void *ctx){
+    struct pipe_slot slots[PIPELINE_DEPTH], *slot;
+    struct pipe_io io;
+    struct stat st;
+    uint8_t *memory, tail[PIPELINE_SLACK];
+    size_t chunks, next_read, next_process, size;
+    off_t start, out_offset;
+    long long total;
+    int i, inflight, writes, error, lost, progress;
+    ssize_t res;
+
+    if(fstat(infd, &st) != 0 || !S_ISREG(st.st_mode))
+        return -1;
+
+    // positional writes for files, a stream takes one write at a time in order
+    start = lseek(outfd, 0, SEEK_CUR);
+    out_offset = start;
+
+    memory = NULL;
+    if(posix_memalign((void**)&memory, 4096, PIPELINE_DEPTH * (2 * (size_t)PIPELINE_CHUNK + PIPELINE_SLACK)) != 0)
+        return -1;
+    if(pipe_io_open(&io) != 0){
+        free(memory);
+        return -1;
+    }
+
+    for(i = 0; i < PIPELINE_DEPTH; i++){
+        slots[i].state = SLOT_FREE;
+        slots[i].in = memory + i * (2 * (size_t)PIPELINE_CHUNK + PIPELINE_SLACK);
+        slots[i].out = slots[i].in + PIPELINE_CHUNK;
+    }
+
+    chunks = ((size_t)st.st_size + PIPELINE_CHUNK - 1) / PIPELINE_CHUNK;
+    next_read = 0;
+    next_process = 0;
+    inflight = 0;
+    writes = 0;
+    error = 0;
+    lost = 0;
+    total = 0;
+
+    for(;;){
+        // every free buffer reads the next chunk
+        for(i = 0; i < PIPELINE_DEPTH && !error && next_read < chunks; i++){
+            slot = &slots[i];
+            if(slot->state != SLOT_FREE)
+                continue;
+
+            slot->seq = next_read++;
+            slot->op = OP_READ;
+            slot->fd = infd;
+            slot->offset = (off_t)slot->seq * PIPELINE_CHUNK;
+            slot->size = ((size_t)st.st_size - slot->offset < PIPELINE_CHUNK) ? (size_t)st.st_size - slot->offset
+                                                                               : PIPELINE_CHUNK;
+            slot->done = 0;
+            slot->state = SLOT_READING;
+            pipe_io_submit(&io, slot);
+            inflight++;
+        }
+
+        // transform the chunks that arrived, in file order, and send them off to be written
+        do{
+            progress = 0;
+            for(i = 0; i < PIPELINE_DEPTH && !error; i++){
+                slot = &slots[i];
+                if(slot->state != SLOT_READY || slot->seq != next_process || (start < 0 && writes > 0))
+                    continue;
+
+                size = update(ctx, slot->in, slot->out, slot->size);
+                next_process++;
+                progress = 1;
+
+                if(size == 0){
+                    slot->state = SLOT_FREE;
+                    continue;
+                }
+
+                slot->op = OP_WRITE;
+                slot->fd = outfd;
+                slot->offset = (start < 0) ? -1 : out_offset;
+                slot->size = size;
+                slot->done = 0;
+                slot->state = SLOT_WRITING;
+                out_offset += size;
+                total += size;
+                pipe_io_submit(&io, slot);
+                inflight++;
+                writes++;
+            }
+        }while(progress);
+
+        if(inflight == 0)
+            break;
+
+        slot = pipe_io_wait(&io, &res);
+        if(slot == NULL){
+            // the ring itself failed, the kernel may still own the buffers so they are not freed
+            error = 1;
+            lost = 1;
+            break;
+        }
+        inflight--;
+
+        // short transfers go again for the rest, errors (or a file that shrank) stop new work and drain the rest
+        if(res <= 0){
+            error = 1;
+            slot->state = SLOT_FREE;
+            if(slot->op == OP_WRITE)
+                writes--;
+            continue;
+        }
+        slot->done += res;
+        if(error){
+            slot->state = SLOT_FREE;
+        }else if(slot->done < slot->size){
+            pipe_io_submit(&io, slot);
+            inflight++;
+        }else if(slot->op == OP_READ){
+            slot->state = SLOT_READY;
+        }else{
+            slot->state = SLOT_FREE;
+            writes--;
+        }
+    }
+
+    pipe_io_close(&io);
+    if(!lost)
+        free(memory);
+
+    if(error)
+        return -1;
+
+    // whatever the context still holds
+    size = final(ctx, tail);
+    if(size > 0 && pipe_write_all(outfd, tail, size, (start < 0) ? -1 : out_offset) != 0)
+        return -1;
+    total += size;
+
+    return total;
+}
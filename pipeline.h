@@ -0,0 +1,31 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PIPELINE_CHUNK      (1 << 20)   // bytes read per buffer
+#define PIPELINE_DEPTH      4           // buffers in flight between reading, transforming and writing
+#define PIPELINE_SLACK      64          // extra output room per chunk for what a context carries over (padding, digrams)
+
+/*
+* transform of a streaming context: update gets the next size bytes of input and writes at most size + PIPELINE_SLACK
+* bytes into out, final writes whatever is left at the end (at most PIPELINE_SLACK bytes). both return bytes written
+*/
+typedef size_t (*pipeline_update_fn)(void *ctx, uint8_t *in, uint8_t *out, size_t size);
+typedef size_t (*pipeline_final_fn)(void *ctx, uint8_t *out);
+
+/*
+* streams the regular file infd through update/final into outfd, keeping PIPELINE_DEPTH chunks in flight so the
+* transform of one chunk overlaps the read of the next and the write of the previous ones. reads and writes go
+* through io_uring, or through pread/pwrite threads if io_uring is missing (or CRYPTO_PIPELINE=threads).
+* returns the bytes written, or -1 on an I/O error
+*/
+long long pipeline_run(int infd, int outfd, pipeline_update_fn update, pipeline_final_fn final, void *ctx);
+
+/*
+* returns the I/O backend pipeline_run uses: "io_uring" or "threads"
+*/
+const char *pipeline_backend(void);
+
+#endif
@@ -0,0 +1,248 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "crypto.h"
+#include "pool.h"
+
+/*
+* the chunks one participant owns, next is taken with an atomic add by the owner and by thieves alike,
+* so stealing needs no lock. a cache line each keeps the counters from bouncing between cores
+*/
+struct pool_range {
+    size_t next;
+    size_t end;
+} __attribute__((aligned(64)));
+
+struct crypto_pool {
+    int threads;                    // participants, the workers plus the submitting thread
+    size_t threshold;               // bytes below which the *_par functions stay on the calling thread
+    pthread_t *tids;
+    struct pool_range *ranges;
+
+    pthread_mutex_t submit;         // one job at a time
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation;       // bumped for every job so workers know there is a new one
+    int busy;                       // workers still running the current job
+    int quit;
+
+    pool_chunk_fn fn;
+    void *arg;
+};
+
+// a worker thread and the participant slot it owns
+struct pool_worker {
+    crypto_pool *pool;
+    int self;
+};
+
+/*
+* runs the chunks of participant self, then steals from the others until every range is empty
+*/
+static void pool_participate(crypto_pool *pool, int self){
+    struct pool_range *range;
+    size_t chunk;
+    int i, victim;
+
+    for(i = 0; i < pool->threads; i++){
+        victim = (self + i) % pool->threads;
+        range = &pool->ranges[victim];
+
+        // keep taking from this range until it runs dry
+        for(;;){
+            chunk = __atomic_fetch_add(&range->next, 1, __ATOMIC_RELAXED);
+            if(chunk >= range->end)
+                break;
+            pool->fn(pool->arg, chunk);
+        }
+    }
+
+    return;
+}
+
+/*
+* worker thread, sleeps until a job is posted, joins it and reports back
+*/
+static void *pool_worker_main(void *arg){
+    struct pool_worker *worker = (struct pool_worker*)arg;
+    crypto_pool *pool = worker->pool;
+    unsigned long seen;
+
+    seen = 0;
+    for(;;){
+        pthread_mutex_lock(&pool->lock);
+        while(pool->generation == seen && !pool->quit)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if(pool->quit){
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool_participate(pool, worker->self);
+
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->busy == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    free(worker);
+
+    return NULL;
+}
+
+/*
+* creates a pool of threads participants (the calling thread counts as one), 0 or less uses every online cpu.
+* returns NULL if it could not be set up
+*/
+crypto_pool *crypto_pool_create(int threads){
+    struct pool_worker *worker;
+    crypto_pool *pool;
+    int t;
+
+    if(threads <= 0)
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads <= 0)
+        threads = 1;
+    if(threads > CRYPTO_POOL_MAX_THREADS)
+        threads = CRYPTO_POOL_MAX_THREADS;
+
+    pool = (crypto_pool*)calloc(1, sizeof(crypto_pool));
+    if(pool == NULL)
+        return NULL;
+
+    pool->threshold = CRYPTO_PAR_MIN_SIZE;
+    pool->tids = (pthread_t*)calloc(threads, sizeof(pthread_t));
+    if(posix_memalign((void**)&pool->ranges, 64, threads * sizeof(struct pool_range)) != 0)
+        pool->ranges = NULL;
+    if(pool->tids == NULL || pool->ranges == NULL){
+        free(pool->tids);
+        free(pool->ranges);
+        free(pool);
+        return NULL;
+    }
+    memset(pool->ranges, 0, threads * sizeof(struct pool_range));
+
+    pthread_mutex_init(&pool->submit, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // the last slot belongs to whoever submits, a worker that fails to start just leaves fewer threads
+    pool->threads = 1;
+    for(t = 0; t < threads - 1; t++){
+        worker = (struct pool_worker*)malloc(sizeof(struct pool_worker));
+        if(worker == NULL)
+            break;
+        worker->pool = pool;
+        worker->self = t;
+        if(pthread_create(&pool->tids[t], NULL, pool_worker_main, worker) != 0){
+            free(worker);
+            break;
+        }
+        pool->threads++;
+    }
+
+    return pool;
+}
+
+/*
+* stops the workers and frees the pool
+*/
+void crypto_pool_destroy(crypto_pool *pool){
+    int t;
+
+    if(pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(t = 0; t < pool->threads - 1; t++)
+        pthread_join(pool->tids[t], NULL);
+
+    pthread_mutex_destroy(&pool->submit);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->tids);
+    free(pool->ranges);
+    free(pool);
+
+    return;
+}
+
+/*
+* returns the number of participants of the pool, the calling thread included
+*/
+int crypto_pool_threads(const crypto_pool *pool){
+    return pool->threads;
+}
+
+/*
+* sets the input size below which the *_par functions run on the calling thread alone
+*/
+void crypto_pool_set_threshold(crypto_pool *pool, size_t threshold){
+    pool->threshold = threshold;
+
+    return;
+}
+
+/*
+* returns the input size below which the *_par functions run on the calling thread alone
+*/
+size_t crypto_pool_threshold(const crypto_pool *pool){
+    return pool->threshold;
+}
+
+/*
+* runs fn for chunks 0 to chunks - 1 across the pool and the calling thread, returns once every chunk is done
+*/
+void pool_run(crypto_pool *pool, size_t chunks, pool_chunk_fn fn, void *arg){
+    size_t per, first;
+    int t, self;
+
+    if(chunks == 0)
+        return;
+
+    pthread_mutex_lock(&pool->submit);
+
+    // contiguous even shares to start from, stealing evens out whatever the split gets wrong
+    per = chunks / pool->threads;
+    for(t = 0, first = 0; t < pool->threads; t++){
+        pool->ranges[t].next = first;
+        first += per + ((size_t)t < chunks % pool->threads);
+        pool->ranges[t].end = first;
+    }
+
+    pool->fn = fn;
+    pool->arg = arg;
+    self = pool->threads - 1;
+
+    if(self > 0){
+        pthread_mutex_lock(&pool->lock);
+        pool->busy = self;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->start);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    pool_participate(pool, self);
+
+    if(self > 0){
+        pthread_mutex_lock(&pool->lock);
+        while(pool->busy > 0)
+            pthread_cond_wait(&pool->done, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    pthread_mutex_unlock(&pool->submit);
+
+    return;
+}
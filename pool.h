@@ -0,0 +1,18 @@
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <stddef.h>
+#include "crypto.h"
+
+/*
+* work run for every chunk index of a pool job, chunks may run in any order on any participant
+*/
+typedef void (*pool_chunk_fn)(void *arg, size_t chunk);
+
+/*
+* runs fn for chunks 0 to chunks - 1 across the pool and the calling thread, returns once every chunk is done.
+* jobs from several threads run one after the other, fn must not submit to the same pool
+*/
+void pool_run(crypto_pool *pool, size_t chunks, pool_chunk_fn fn, void *arg);
+
+#endif
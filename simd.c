@@ -0,0 +1,636 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "crypto.h"
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#endif
+
+// mult * x + inc stays below 2^16 and dividing it by 26 is a multiply by 2521 / 2^16, exact for every 0-25 operand
+#define DIV26_MAGIC         2521
+
+static const simd_kernels *simd_active;
+
+// for every 8 bit keep mask the positions of its set bits packed to the front, and how many there are
+static uint8_t compact_lut[256][8];
+static uint8_t compact_count[256];
+
+/*
+* the original per byte caesar arithmetic, used for the tails the vector loops leave behind
+*/
+static inline uint8_t caesar_byte(uint8_t c, int shift){
+    if(c >= 'a' && c <= 'z'){
+        c = c - 'a' + 36;
+    }else
+    if(c >= 'A' && c <= 'Z'){
+        c = c - 'A' + 10;
+    }else
+    if(c >= '0' && c <= '9'){
+        c = c - '0';
+    }else{
+        return c;
+    }
+
+    c = (c + shift) % 62;
+
+    if(c <= 9)
+        return c + '0';
+    if(c <= 35)
+        return 'A' + (c - 10);
+    return 'a' + (c - 36);
+}
+
+/*
+* the original per byte affine arithmetic, used for the tails the vector loops leave behind
+*/
+static inline uint8_t affine_byte(uint8_t c, int mult, int inc){
+    if(c < 'A' || c > 'Z')
+        return c;
+
+    return 'A' + (mult * (c - 'A') + inc) % 26;
+}
+
+/*
+* scalar xor, also the tail of the vector ones
+*/
+static void xor_scalar(const uint8_t *in, const uint8_t *key, uint8_t *out, size_t size){
+    size_t i;
+
+    for(i = 0; i < size; i++)
+        out[i] = in[i] ^ key[i];
+
+    return;
+}
+
+/*
+* per byte filters for the tails the vector loops leave behind
+*/
+static size_t otp_filter_scalar(const uint8_t *in, uint8_t *out, size_t size){
+    size_t i, j;
+    uint8_t c;
+
+    for(i = 0, j = 0; i < size; i++){
+        c = in[i];
+        if((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == ' ')
+            out[j++] = c;
+    }
+
+    return j;
+}
+
+static size_t letter_filter_scalar(const uint8_t *in, uint8_t *out, size_t size){
+    size_t i, j;
+
+    for(i = 0, j = 0; i < size; i++){
+        if(in[i] >= 'A' && in[i] <= 'Z')
+            out[j++] = (in[i] == 'I') ? 'J' : in[i];
+    }
+
+    return j;
+}
+
+/*
+* fills the compaction table the pshufb filters use
+*/
+static void compact_lut_init(void){
+    int mask, bit, n;
+
+    for(mask = 0; mask < 256; mask++){
+        for(bit = 0, n = 0; bit < 8; bit++){
+            if(mask & (1 << bit))
+                compact_lut[mask][n++] = bit;
+        }
+        compact_count[mask] = n;
+
+        // the unused slots repeat the last lane, they land past the kept bytes
+        for(; n < 8; n++)
+            compact_lut[mask][n] = 7;
+    }
+
+    return;
+}
+
+#ifdef SIMD_X86
+
+/*
+* lanes of v within [lo, lo + n)
+*/
+static inline __m128i sse2_in_range(__m128i v, uint8_t lo, uint8_t n){
+    __m128i x = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+
+    return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(n - 1)), x);
+}
+
+/*
+* caesar over 16 bytes: symbol index by class, add the shift, wrap at 62 and map back to its class
+*/
+static inline __m128i sse2_caesar_vec(__m128i v, __m128i shift){
+    __m128i digit, upper, lower, alpha, off, t, wrap, lt10, lt36, back;
+
+    digit = sse2_in_range(v, '0', 10);
+    upper = sse2_in_range(v, 'A', 26);
+    lower = sse2_in_range(v, 'a', 26);
+    alpha = _mm_or_si128(digit, _mm_or_si128(upper, lower));
+
+    // offset taking every class to its 0-61 index
+    off = _mm_and_si128(digit, _mm_set1_epi8(-'0'));
+    off = _mm_or_si128(off, _mm_and_si128(upper, _mm_set1_epi8(10 - 'A')));
+    off = _mm_or_si128(off, _mm_and_si128(lower, _mm_set1_epi8(36 - 'a')));
+    t = _mm_add_epi8(_mm_add_epi8(v, off), shift);
+
+    // t is at most 122 so one conditional subtract wraps it
+    wrap = _mm_cmpeq_epi8(_mm_max_epu8(t, _mm_set1_epi8(62)), t);
+    t = _mm_sub_epi8(t, _mm_and_si128(wrap, _mm_set1_epi8(62)));
+
+    // offset back to the class of the result
+    lt10 = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(9)), t);
+    lt36 = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(35)), t);
+    back = _mm_and_si128(lt10, _mm_set1_epi8('0'));
+    back = _mm_or_si128(back, _mm_and_si128(_mm_andnot_si128(lt10, lt36), _mm_set1_epi8('A' - 10)));
+    back = _mm_or_si128(back, _mm_andnot_si128(lt36, _mm_set1_epi8('a' - 36)));
+    t = _mm_add_epi8(t, back);
+
+    return _mm_or_si128(_mm_and_si128(alpha, t), _mm_andnot_si128(alpha, v));
+}
+
+static void sse2_caesar(const uint8_t *in, uint8_t *out, size_t size, int shift){
+    __m128i s = _mm_set1_epi8(shift);
+    size_t i;
+
+    for(i = 0; i + 16 <= size; i += 16)
+        _mm_storeu_si128((__m128i*)(out + i), sse2_caesar_vec(_mm_loadu_si128((const __m128i*)(in + i)), s));
+
+    for(; i < size; i++)
+        out[i] = caesar_byte(in[i], shift);
+
+    return;
+}
+
+/*
+* (mult * x + inc) % 26 on eight 16 bit lanes
+*/
+static inline __m128i sse2_mod26_16(__m128i x, __m128i mult, __m128i inc){
+    __m128i y, q;
+
+    y = _mm_add_epi16(_mm_mullo_epi16(x, mult), inc);
+    q = _mm_mulhi_epu16(y, _mm_set1_epi16(DIV26_MAGIC));
+
+    return _mm_sub_epi16(y, _mm_mullo_epi16(q, _mm_set1_epi16(26)));
+}
+
+/*
+* affine over 16 bytes, widened to 16 bit lanes for the multiply and the modulo
+*/
+static inline __m128i sse2_affine_vec(__m128i v, __m128i mult, __m128i inc){
+    __m128i alpha, x, lo, hi, r;
+
+    alpha = sse2_in_range(v, 'A', 26);
+    x = _mm_sub_epi8(v, _mm_set1_epi8('A'));
+
+    lo = sse2_mod26_16(_mm_unpacklo_epi8(x, _mm_setzero_si128()), mult, inc);
+    hi = sse2_mod26_16(_mm_unpackhi_epi8(x, _mm_setzero_si128()), mult, inc);
+    r = _mm_add_epi8(_mm_packus_epi16(lo, hi), _mm_set1_epi8('A'));
+
+    return _mm_or_si128(_mm_and_si128(alpha, r), _mm_andnot_si128(alpha, v));
+}
+
+static void sse2_affine(const uint8_t *in, uint8_t *out, size_t size, int mult, int inc){
+    __m128i m = _mm_set1_epi16(mult), a = _mm_set1_epi16(inc);
+    size_t i;
+
+    for(i = 0; i + 16 <= size; i += 16)
+        _mm_storeu_si128((__m128i*)(out + i), sse2_affine_vec(_mm_loadu_si128((const __m128i*)(in + i)), m, a));
+
+    for(; i < size; i++)
+        out[i] = affine_byte(in[i], mult, inc);
+
+    return;
+}
+
+static void sse2_xor(const uint8_t *in, const uint8_t *key, uint8_t *out, size_t size){
+    __m128i v, k;
+    size_t i;
+
+    for(i = 0; i + 16 <= size; i += 16){
+        v = _mm_loadu_si128((const __m128i*)(in + i));
+        k = _mm_loadu_si128((const __m128i*)(key + i));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_xor_si128(v, k));
+    }
+
+    xor_scalar(in + i, key + i, out + i, size - i);
+
+    return;
+}
+
+/*
+* 32 byte versions of the sse2 kernels above, same steps on ymm registers
+*/
+__attribute__((target("avx2")))
+static inline __m256i avx2_in_range(__m256i v, uint8_t lo, uint8_t n){
+    __m256i x = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(n - 1)), x);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_caesar_vec(__m256i v, __m256i shift){
+    __m256i digit, upper, lower, alpha, off, t, wrap, lt10, lt36, back;
+
+    digit = avx2_in_range(v, '0', 10);
+    upper = avx2_in_range(v, 'A', 26);
+    lower = avx2_in_range(v, 'a', 26);
+    alpha = _mm256_or_si256(digit, _mm256_or_si256(upper, lower));
+
+    off = _mm256_and_si256(digit, _mm256_set1_epi8(-'0'));
+    off = _mm256_or_si256(off, _mm256_and_si256(upper, _mm256_set1_epi8(10 - 'A')));
+    off = _mm256_or_si256(off, _mm256_and_si256(lower, _mm256_set1_epi8(36 - 'a')));
+    t = _mm256_add_epi8(_mm256_add_epi8(v, off), shift);
+
+    wrap = _mm256_cmpeq_epi8(_mm256_max_epu8(t, _mm256_set1_epi8(62)), t);
+    t = _mm256_sub_epi8(t, _mm256_and_si256(wrap, _mm256_set1_epi8(62)));
+
+    lt10 = _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(9)), t);
+    lt36 = _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(35)), t);
+    back = _mm256_blendv_epi8(_mm256_set1_epi8('a' - 36), _mm256_set1_epi8('A' - 10), lt36);
+    back = _mm256_blendv_epi8(back, _mm256_set1_epi8('0'), lt10);
+    t = _mm256_add_epi8(t, back);
+
+    return _mm256_blendv_epi8(v, t, alpha);
+}
+
+__attribute__((target("avx2")))
+static void avx2_caesar(const uint8_t *in, uint8_t *out, size_t size, int shift){
+    __m256i s = _mm256_set1_epi8(shift);
+    size_t i;
+
+    for(i = 0; i + 32 <= size; i += 32)
+        _mm256_storeu_si256((__m256i*)(out + i), avx2_caesar_vec(_mm256_loadu_si256((const __m256i*)(in + i)), s));
+
+    sse2_caesar(in + i, out + i, size - i, shift);
+
+    return;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_mod26_16(__m256i x, __m256i mult, __m256i inc){
+    __m256i y, q;
+
+    y = _mm256_add_epi16(_mm256_mullo_epi16(x, mult), inc);
+    q = _mm256_mulhi_epu16(y, _mm256_set1_epi16(DIV26_MAGIC));
+
+    return _mm256_sub_epi16(y, _mm256_mullo_epi16(q, _mm256_set1_epi16(26)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_affine_vec(__m256i v, __m256i mult, __m256i inc){
+    __m256i alpha, x, lo, hi, r;
+
+    alpha = avx2_in_range(v, 'A', 26);
+    x = _mm256_sub_epi8(v, _mm256_set1_epi8('A'));
+
+    // unpack and pack both work per 128 bit lane so the byte order comes back unchanged
+    lo = avx2_mod26_16(_mm256_unpacklo_epi8(x, _mm256_setzero_si256()), mult, inc);
+    hi = avx2_mod26_16(_mm256_unpackhi_epi8(x, _mm256_setzero_si256()), mult, inc);
+    r = _mm256_add_epi8(_mm256_packus_epi16(lo, hi), _mm256_set1_epi8('A'));
+
+    return _mm256_blendv_epi8(v, r, alpha);
+}
+
+__attribute__((target("avx2")))
+static void avx2_affine(const uint8_t *in, uint8_t *out, size_t size, int mult, int inc){
+    __m256i m = _mm256_set1_epi16(mult), a = _mm256_set1_epi16(inc);
+    size_t i;
+
+    for(i = 0; i + 32 <= size; i += 32)
+        _mm256_storeu_si256((__m256i*)(out + i), avx2_affine_vec(_mm256_loadu_si256((const __m256i*)(in + i)), m, a));
+
+    sse2_affine(in + i, out + i, size - i, mult, inc);
+
+    return;
+}
+
+__attribute__((target("avx2")))
+static void avx2_xor(const uint8_t *in, const uint8_t *key, uint8_t *out, size_t size){
+    __m256i v, k;
+    size_t i;
+
+    for(i = 0; i + 32 <= size; i += 32){
+        v = _mm256_loadu_si256((const __m256i*)(in + i));
+        k = _mm256_loadu_si256((const __m256i*)(key + i));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_xor_si256(v, k));
+    }
+
+    sse2_xor(in + i, key + i, out + i, size - i);
+
+    return;
+}
+
+/*
+* packs the lanes of v set in the 16 bit mask to the front of out, one pshufb per half through the compaction table.
+* writes 8 bytes per half whatever the mask, returns how many lanes were kept
+*/
+__attribute__((target("ssse3")))
+static inline size_t ssse3_compact16(__m128i v, unsigned mask, uint8_t *out){
+    unsigned lo = mask & 0xff, hi = (mask >> 8) & 0xff;
+    __m128i shuffle, packed;
+
+    shuffle = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)compact_lut[lo]),
+                                 _mm_add_epi8(_mm_loadl_epi64((const __m128i*)compact_lut[hi]), _mm_set1_epi8(8)));
+    packed = _mm_shuffle_epi8(v, shuffle);
+
+    _mm_storel_epi64((__m128i*)out, packed);
+    _mm_storel_epi64((__m128i*)(out + compact_count[lo]), _mm_unpackhi_epi64(packed, packed));
+
+    return compact_count[lo] + compact_count[hi];
+}
+
+/*
+* packs the lanes of v set in the 32 bit mask to the front of out, a whole store when every lane is kept
+*/
+__attribute__((target("avx2")))
+static inline size_t avx2_compact32(__m256i v, uint32_t mask, uint8_t *out){
+    size_t n;
+
+    if(mask == 0xffffffff){
+        _mm256_storeu_si256((__m256i*)out, v);
+        return 32;
+    }
+
+    n = ssse3_compact16(_mm256_castsi256_si128(v), mask & 0xffff, out);
+
+    return n + ssse3_compact16(_mm256_extracti128_si256(v, 1), mask >> 16, out + n);
+}
+
+/*
+* the filters 32 bytes at a time, the stores of a block stay within the bytes it loaded so out may be in itself
+*/
+__attribute__((target("avx2")))
+static size_t avx2_otp_filter(const uint8_t *in, uint8_t *out, size_t size){
+    __m256i v, keep;
+    size_t i, j;
+
+    for(i = 0, j = 0; i + 32 <= size; i += 32){
+        v = _mm256_loadu_si256((const __m256i*)(in + i));
+        keep = _mm256_or_si256(avx2_in_range(v, '0', 10), avx2_in_range(v, 'A', 26));
+        keep = _mm256_or_si256(keep, avx2_in_range(v, 'a', 26));
+        keep = _mm256_or_si256(keep, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+        j += avx2_compact32(v, (uint32_t)_mm256_movemask_epi8(keep), out + j);
+    }
+
+    return j + otp_filter_scalar(in + i, out + j, size - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_letter_filter(const uint8_t *in, uint8_t *out, size_t size){
+    __m256i v, keep;
+    size_t i, j;
+
+    for(i = 0, j = 0; i + 32 <= size; i += 32){
+        v = _mm256_loadu_si256((const __m256i*)(in + i));
+        keep = avx2_in_range(v, 'A', 26);
+
+        // I lanes compare to -1, subtracting that makes them J
+        v = _mm256_sub_epi8(v, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('I')));
+        j += avx2_compact32(v, (uint32_t)_mm256_movemask_epi8(keep), out + j);
+    }
+
+    return j + letter_filter_scalar(in + i, out + j, size - i);
+}
+
+/*
+* 64 byte versions using mask registers, the tail is a masked load/store instead of a scalar loop
+*/
+__attribute__((target("avx512bw,bmi2")))
+static inline __mmask64 avx512_in_range(__m512i v, uint8_t lo, uint8_t n){
+    return _mm512_cmplt_epu8_mask(_mm512_sub_epi8(v, _mm512_set1_epi8(lo)), _mm512_set1_epi8(n));
+}
+
+__attribute__((target("avx512bw,bmi2")))
+static inline __m512i avx512_caesar_vec(__m512i v, __m512i shift){
+    __mmask64 digit, upper, lower;
+    __m512i off, t, back;
+
+    digit = avx512_in_range(v, '0', 10);
+    upper = avx512_in_range(v, 'A', 26);
+    lower = avx512_in_range(v, 'a', 26);
+
+    off = _mm512_maskz_mov_epi8(digit, _mm512_set1_epi8(-'0'));
+    off = _mm512_mask_mov_epi8(off, upper, _mm512_set1_epi8(10 - 'A'));
+    off = _mm512_mask_mov_epi8(off, lower, _mm512_set1_epi8(36 - 'a'));
+    t = _mm512_add_epi8(_mm512_add_epi8(v, off), shift);
+
+    t = _mm512_mask_sub_epi8(t, _mm512_cmpge_epu8_mask(t, _mm512_set1_epi8(62)), t, _mm512_set1_epi8(62));
+
+    back = _mm512_set1_epi8('a' - 36);
+    back = _mm512_mask_mov_epi8(back, _mm512_cmple_epu8_mask(t, _mm512_set1_epi8(35)), _mm512_set1_epi8('A' - 10));
+    back = _mm512_mask_mov_epi8(back, _mm512_cmple_epu8_mask(t, _mm512_set1_epi8(9)), _mm512_set1_epi8('0'));
+
+    return _mm512_mask_add_epi8(v, digit | upper | lower, t, back);
+}
+
+__attribute__((target("avx512bw,bmi2")))
+static void avx512_caesar(const uint8_t *in, uint8_t *out, size_t size, int shift){
+    __m512i s = _mm512_set1_epi8(shift);
+    __mmask64 tail;
+    size_t i;
+
+    for(i = 0; i + 64 <= size; i += 64)
+        _mm512_storeu_si512(out + i, avx512_caesar_vec(_mm512_loadu_si512(in + i), s));
+
+    if(i < size){
+        tail = _bzhi_u64(~0ULL, size - i);
+        _mm512_mask_storeu_epi8(out + i, tail, avx512_caesar_vec(_mm512_maskz_loadu_epi8(tail, in + i), s));
+    }
+
+    return;
+}
+
+__attribute__((target("avx512bw,bmi2")))
+static inline __m512i avx512_mod26_16(__m512i x, __m512i mult, __m512i inc){
+    __m512i y, q;
+
+    y = _mm512_add_epi16(_mm512_mullo_epi16(x, mult), inc);
+    q = _mm512_mulhi_epu16(y, _mm512_set1_epi16(DIV26_MAGIC));
+
+    return _mm512_sub_epi16(y, _mm512_mullo_epi16(q, _mm512_set1_epi16(26)));
+}
+
+__attribute__((target("avx512bw,bmi2")))
+static inline __m512i avx512_affine_vec(__m512i v, __m512i mult, __m512i inc){
+    __mmask64 alpha;
+    __m512i x, lo, hi, r;
+
+    alpha = avx512_in_range(v, 'A', 26);
+    x = _mm512_sub_epi8(v, _mm512_set1_epi8('A'));
+
+    lo = avx512_mod26_16(_mm512_unpacklo_epi8(x, _mm512_setzero_si512()), mult, inc);
+    hi = avx512_mod26_16(_mm512_unpackhi_epi8(x, _mm512_setzero_si512()), mult, inc);
+    r = _mm512_add_epi8(_mm512_packus_epi16(lo, hi), _mm512_set1_epi8('A'));
+
+    return _mm512_mask_mov_epi8(v, alpha, r);
+}
+
+__attribute__((target("avx512bw,bmi2")))
+static void avx512_affine(const uint8_t *in, uint8_t *out, size_t size, int mult, int inc){
+    __m512i m = _mm512_set1_epi16(mult), a = _mm512_set1_epi16(inc);
+    __mmask64 tail;
+    size_t i;
+
+    for(i = 0; i + 64 <= size; i += 64)
+        _mm512_storeu_si512(out + i, avx512_affine_vec(_mm512_loadu_si512(in + i), m, a));
+
+    if(i < size){
+        tail = _bzhi_u64(~0ULL, size - i);
+        _mm512_mask_storeu_epi8(out + i, tail, avx512_affine_vec(_mm512_maskz_loadu_epi8(tail, in + i), m, a));
+    }
+
+    return;
+}
+
+__attribute__((target("avx512bw,bmi2")))
+static void avx512_xor(const uint8_t *in, const uint8_t *key, uint8_t *out, size_t size){
+    __mmask64 tail;
+    size_t i;
+
+    for(i = 0; i + 64 <= size; i += 64)
+        _mm512_storeu_si512(out + i, _mm512_xor_si512(_mm512_loadu_si512(in + i), _mm512_loadu_si512(key + i)));
+
+    if(i < size){
+        tail = _bzhi_u64(~0ULL, size - i);
+        _mm512_mask_storeu_epi8(out + i, tail, _mm512_xor_si512(_mm512_maskz_loadu_epi8(tail, in + i), _mm512_maskz_loadu_epi8(tail, key + i)));
+    }
+
+    return;
+}
+
+/*
+* the filters with vbmi2, vpcompressb packs the kept lanes of 64 bytes in one instruction
+*/
+__attribute__((target("avx512bw,avx512vbmi2,bmi2,popcnt")))
+static inline __mmask64 avx512_otp_keep(__m512i v){
+    return avx512_in_range(v, '0', 10) | avx512_in_range(v, 'A', 26) | avx512_in_range(v, 'a', 26) |
+           _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(' '));
+}
+
+__attribute__((target("avx512bw,avx512vbmi2,bmi2,popcnt")))
+static size_t vbmi2_otp_filter(const uint8_t *in, uint8_t *out, size_t size){
+    __mmask64 keep, tail;
+    __m512i v;
+    size_t i, j;
+
+    for(i = 0, j = 0; i + 64 <= size; i += 64){
+        v = _mm512_loadu_si512(in + i);
+        keep = avx512_otp_keep(v);
+        _mm512_storeu_si512(out + j, _mm512_maskz_compress_epi8(keep, v));
+        j += _mm_popcnt_u64(keep);
+    }
+
+    if(i < size){
+        tail = _bzhi_u64(~0ULL, size - i);
+        v = _mm512_maskz_loadu_epi8(tail, in + i);
+        keep = avx512_otp_keep(v) & tail;
+        _mm512_mask_storeu_epi8(out + j, _bzhi_u64(~0ULL, _mm_popcnt_u64(keep)), _mm512_maskz_compress_epi8(keep, v));
+        j += _mm_popcnt_u64(keep);
+    }
+
+    return j;
+}
+
+__attribute__((target("avx512bw,avx512vbmi2,bmi2,popcnt")))
+static size_t vbmi2_letter_filter(const uint8_t *in, uint8_t *out, size_t size){
+    __mmask64 keep, tail;
+    __m512i v;
+    size_t i, j;
+
+    for(i = 0, j = 0; i + 64 <= size; i += 64){
+        v = _mm512_loadu_si512(in + i);
+        keep = avx512_in_range(v, 'A', 26);
+        v = _mm512_mask_add_epi8(v, _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('I')), v, _mm512_set1_epi8(1));
+        _mm512_storeu_si512(out + j, _mm512_maskz_compress_epi8(keep, v));
+        j += _mm_popcnt_u64(keep);
+    }
+
+    if(i < size){
+        tail = _bzhi_u64(~0ULL, size - i);
+        v = _mm512_maskz_loadu_epi8(tail, in + i);
+        keep = avx512_in_range(v, 'A', 26) & tail;
+        v = _mm512_mask_add_epi8(v, _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('I')), v, _mm512_set1_epi8(1));
+        _mm512_mask_storeu_epi8(out + j, _bzhi_u64(~0ULL, _mm_popcnt_u64(keep)), _mm512_maskz_compress_epi8(keep, v));
+        j += _mm_popcnt_u64(keep);
+    }
+
+    return j;
+}
+
+#endif
+
+static const simd_kernels scalar_kernels = {"scalar", NULL, NULL, xor_scalar, NULL, NULL};
+
+// sse2 has no byte shuffle and avx512bw no byte compress, they filter in crypto.c and with the avx2 kernels
+#ifdef SIMD_X86
+static const simd_kernels sse2_kernels = {"sse2", sse2_caesar, sse2_affine, sse2_xor, NULL, NULL};
+static const simd_kernels avx2_kernels = {"avx2", avx2_caesar, avx2_affine, avx2_xor, avx2_otp_filter, avx2_letter_filter};
+static const simd_kernels avx512_kernels = {"avx512", avx512_caesar, avx512_affine, avx512_xor, avx2_otp_filter, avx2_letter_filter};
+static const simd_kernels vbmi2_kernels = {"avx512vbmi2", avx512_caesar, avx512_affine, avx512_xor, vbmi2_otp_filter, vbmi2_letter_filter};
+#endif
+
+/*
+* picks the kernels at startup from cpuid, CRYPTO_SIMD=scalar|sse2|avx2|avx512|avx512vbmi2 in the environment caps the
+* choice
+*/
+__attribute__((constructor))
+static void simd_select(void){
+    const char *cap = getenv("CRYPTO_SIMD");
+
+    compact_lut_init();
+
+    simd_active = &scalar_kernels;
+    if(cap && strcmp(cap, "scalar") == 0)
+        return;
+
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("sse2"))
+        simd_active = &sse2_kernels;
+    if(cap && strcmp(cap, "sse2") == 0)
+        return;
+
+    if(__builtin_cpu_supports("avx2"))
+        simd_active = &avx2_kernels;
+    if(cap && strcmp(cap, "avx2") == 0)
+        return;
+
+    // _bzhi_u64 in the tails needs bmi2, every avx512bw part has it
+    if(__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("bmi2"))
+        simd_active = &avx512_kernels;
+    if(cap && strcmp(cap, "avx512") == 0)
+        return;
+
+    if(simd_active == &avx512_kernels && __builtin_cpu_supports("avx512vbmi2") && __builtin_cpu_supports("popcnt"))
+        simd_active = &vbmi2_kernels;
+#endif
+
+    return;
+}
+
+/*
+* returns the kernels selected for this cpu
+*/
+const simd_kernels *simd_get(void){
+    if(!simd_active)
+        simd_select();
+
+    return simd_active;
+}
+
+/*
+* name of the instruction set the byte ciphers run on (scalar, sse2, avx2, avx512 or avx512vbmi2)
+*/
+const char *crypto_simd_name(void){
+    return simd_get()->name;
+}
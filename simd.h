@@ -0,0 +1,36 @@
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#include <stdint.h>
+
+/*
+* byte transform kernels of the widest instruction set the cpu supports, picked once at startup.
+* the scalar set leaves caesar and affine empty so callers go through their substitution tables instead, sets
+* without a byte shuffle leave the filters empty for the per byte loops of crypto.c
+*/
+typedef struct simd_kernels {
+    const char *name;
+
+    // shift 0-9A-Za-z by shift (0-61) around the 62 symbol alphabet, everything else is copied
+    void (*caesar)(const uint8_t *in, uint8_t *out, size_t size, int shift);
+
+    // map A-Z through (mult * x + inc) % 26 with mult and inc in 0-25, everything else is copied
+    void (*affine)(const uint8_t *in, uint8_t *out, size_t size, int mult, int inc);
+
+    // out = in ^ key
+    void (*xor)(const uint8_t *in, const uint8_t *key, uint8_t *out, size_t size);
+
+    // keep 0-9A-Za-z and space packed to the front of out (may be in itself), returns how many were kept.
+    // the bytes of out past the kept ones may be overwritten
+    size_t (*otp_filter)(const uint8_t *in, uint8_t *out, size_t size);
+
+    // same for A-Z with every I turned into a J on the way, the playfair alphabet
+    size_t (*letter_filter)(const uint8_t *in, uint8_t *out, size_t size);
+} simd_kernels;
+
+/*
+* returns the kernels selected for this cpu
+*/
+const simd_kernels *simd_get(void);
+
+#endif
@@ -0,0 +1,492 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "crypto.h"
+#include "pool.h"
+#include "arena.h"
+
+#define SOLVE_TEMP_LETTER   0.0125      // default starting temperature per ciphertext letter, a move changes more quadgrams
+                                        // the longer the text so the temperature has to scale with it
+#define SOLVE_TEMP_MIN      1.0
+#define SOLVE_LETTER_J      ('J' - 'A')
+#define SOLVE_LETTER_I      ('I' - 'A')
+
+// row and column of every grid position
+static const uint8_t solve_row[25] = {0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4};
+static const uint8_t solve_col[25] = {0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0, 1, 2, 3, 4};
+
+// positions a digram at positions (a, b) decrypts to, the same for every grid so candidates need no digram tables
+static uint8_t solve_digram[25 * 25][2];
+static pthread_once_t solve_once = PTHREAD_ONCE_INIT;
+
+// a grid of letters counted from A and where every letter sits on it
+struct solve_grid {
+    uint8_t cell[25];
+    uint8_t pos[26];
+};
+
+// one annealing chain, the best grid it found and its score
+struct solve_chain {
+    struct solve_grid best;
+    double score;
+    uint64_t keys;
+};
+
+// the chains of one playfair_solve run, the ciphertext as letter codes and one plaintext buffer per chain
+struct solve_job {
+    const uint8_t *text;
+    size_t size;
+    uint8_t *plain;
+    const float *model;
+    const playfair_solve_params *params;
+    struct solve_chain *chains;
+};
+
+/*
+* letter code of c for a quadgram, I counted as J like the playfair alphabet. 26 for anything but a letter
+*/
+static inline int quadgram_letter(uint8_t c){
+    if(c >= 'a' && c <= 'z')
+        c -= 'a' - 'A';
+    if(c < 'A' || c > 'Z')
+        return 26;
+
+    return c - 'A' == SOLVE_LETTER_I ? SOLVE_LETTER_J : c - 'A';
+}
+
+/*
+* turns the quadgram counts into the log10 probabilities of the model, unseen quadgrams get a hundredth of a count.
+* returns 0, or -1 if out of memory or nothing was counted
+*/
+static int quadgram_model_fill(quadgram_model *model, const double *counts){
+    double total = 0, floor_score;
+    size_t q;
+
+    for(q = 0; q < QUADGRAM_COUNT; q++)
+        total += counts[q];
+    if(total == 0)
+        return -1;
+
+    model->score = (float*)arena_get(QUADGRAM_COUNT * sizeof(float));
+    if(model->score == NULL)
+        return -1;
+
+    floor_score = log10(0.01 / total);
+    for(q = 0; q < QUADGRAM_COUNT; q++)
+        model->score[q] = counts[q] > 0 ? log10(counts[q] / total) : floor_score;
+
+    return 0;
+}
+
+/*
+* counts every run of 4 letters of length bytes of text into counts, anything but a letter ends a run
+*/
+static void quadgram_count(const uint8_t *text, size_t length, double *counts){
+    size_t i, run = 0;
+    uint32_t q = 0;
+    int c;
+
+    for(i = 0; i < length; i++){
+        c = quadgram_letter(text[i]);
+        if(c == 26){
+            run = 0;
+            continue;
+        }
+        q = (q % (26 * 26 * 26)) * 26 + c;
+        if(++run >= 4)
+            counts[q]++;
+    }
+
+    return;
+}
+
+/*
+* parses "ABCD count" lines into counts, returns 0 or -1 if the data is not in that format
+*/
+static int quadgram_parse(const uint8_t *data, size_t length, double *counts){
+    size_t i = 0, k;
+    uint32_t q;
+    double count;
+    int c;
+
+    while(i < length){
+        // skip blank lines
+        if(data[i] == '\n' || data[i] == '\r'){
+            i++;
+            continue;
+        }
+
+        for(q = 0, k = 0; k < 4; k++){
+            if(i + k >= length || (c = quadgram_letter(data[i + k])) == 26)
+                return -1;
+            q = q * 26 + c;
+        }
+        for(i += 4; i < length && (data[i] == ' ' || data[i] == '\t'); i++)
+            ;
+        if(i >= length || data[i] < '0' || data[i] > '9')
+            return -1;
+        for(count = 0; i < length && data[i] >= '0' && data[i] <= '9'; i++)
+            count = count * 10 + (data[i] - '0');
+        counts[q] += count;
+
+        while(i < length && data[i] != '\n')
+            i++;
+    }
+
+    return 0;
+}
+
+/*
+* builds a quadgram model from length bytes of english text, case and everything but letters ignored.
+* returns 0, or -1 if out of memory or the text has no 4 letter run
+*/
+int quadgram_model_train(quadgram_model *model, uint8_t *text, size_t length){
+    double *counts;
+    int result;
+
+    counts = (double*)arena_get(QUADGRAM_COUNT * sizeof(double));
+    if(counts == NULL)
+        return -1;
+    memset(counts, 0, QUADGRAM_COUNT * sizeof(double));
+
+    quadgram_count(text, length, counts);
+    result = quadgram_model_fill(model, counts);
+    arena_put(counts, QUADGRAM_COUNT * sizeof(double));
+
+    return result;
+}
+
+/*
+* builds a quadgram model from the file at path: "ABCD count" lines as published with the usual quadgram statistics,
+* or any other file taken as english text to count. returns 0, or -1 if it could not be read or had nothing to count
+*/
+int quadgram_model_load(quadgram_model *model, const char *path){
+    struct stat st;
+    uint8_t *data;
+    double *counts;
+    size_t done;
+    ssize_t got;
+    int fd, result;
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return -1;
+    if(fstat(fd, &st) != 0 || (data = (uint8_t*)arena_get(st.st_size + 1)) == NULL){
+        close(fd);
+        return -1;
+    }
+    for(done = 0; done < (size_t)st.st_size; done += got){
+        got = read(fd, data + done, st.st_size - done);
+        if(got <= 0)
+            break;
+    }
+    close(fd);
+
+    counts = (double*)arena_get(QUADGRAM_COUNT * sizeof(double));
+    if(counts == NULL){
+        arena_put(data, st.st_size + 1);
+        return -1;
+    }
+    memset(counts, 0, QUADGRAM_COUNT * sizeof(double));
+
+    // not a count list, start over counting it as text
+    if(quadgram_parse(data, done, counts) != 0){
+        memset(counts, 0, QUADGRAM_COUNT * sizeof(double));
+        quadgram_count(data, done, counts);
+    }
+    result = quadgram_model_fill(model, counts);
+
+    arena_put(counts, QUADGRAM_COUNT * sizeof(double));
+    arena_put(data, st.st_size + 1);
+
+    return result;
+}
+
+/*
+* frees the table of a model made by quadgram_model_train or quadgram_model_load
+*/
+void quadgram_model_free(quadgram_model *model){
+    arena_put(model->score, QUADGRAM_COUNT * sizeof(float));
+    model->score = NULL;
+
+    return;
+}
+
+/*
+* pthread_once body applying the decryption rules to every pair of positions
+*/
+static void solve_digram_init(void){
+    int a, b;
+
+    for(a = 0; a < 25; a++){
+        for(b = 0; b < 25; b++){
+            if(solve_row[a] == solve_row[b]){ // same row, one to the left
+                solve_digram[a * 25 + b][0] = solve_row[a] * 5 + (solve_col[a] + 4) % 5;
+                solve_digram[a * 25 + b][1] = solve_row[b] * 5 + (solve_col[b] + 4) % 5;
+            }else if(solve_col[a] == solve_col[b]){ // same column, one up
+                solve_digram[a * 25 + b][0] = ((solve_row[a] + 4) % 5) * 5 + solve_col[a];
+                solve_digram[a * 25 + b][1] = ((solve_row[b] + 4) % 5) * 5 + solve_col[b];
+            }else{ // square
+                solve_digram[a * 25 + b][0] = solve_row[a] * 5 + solve_col[b];
+                solve_digram[a * 25 + b][1] = solve_row[b] * 5 + solve_col[a];
+            }
+        }
+    }
+
+    return;
+}
+
+/*
+* next number of a chain's xorshift64* generator, the moves need speed rather than key quality
+*/
+static inline uint64_t solve_random(uint64_t *state){
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 0x2545f4914f6cdd1dull;
+}
+
+/*
+* random number from 0 to n - 1
+*/
+static inline int solve_below(uint64_t *state, int n){
+    return (int)(((solve_random(state) >> 32) * n) >> 32);
+}
+
+/*
+* rebuilds the letter positions after the cells moved
+*/
+static inline void solve_index(struct solve_grid *grid){
+    int i;
+
+    for(i = 0; i < 25; i++)
+        grid->pos[grid->cell[i]] = i;
+
+    return;
+}
+
+/*
+* mutates grid in place: mostly a swap of two letters, sometimes two rows or columns swapped, the rows or columns
+* reversed or the grid transposed
+*/
+static void solve_move(struct solve_grid *grid, uint64_t *state){
+    uint8_t cell[25], tmp;
+    int move, a, b, i;
+
+    move = solve_below(state, 50);
+    a = solve_below(state, 25);
+    b = solve_below(state, 25);
+
+    if(move >= 5){
+        tmp = grid->cell[a];
+        grid->cell[a] = grid->cell[b];
+        grid->cell[b] = tmp;
+    }else{
+        memcpy(cell, grid->cell, 25);
+        a %= 5;
+        b %= 5;
+        for(i = 0; i < 25; i++){
+            switch(move){
+            case 0: // swap rows a and b
+                grid->cell[i] = cell[solve_row[i] == a ? b * 5 + solve_col[i] : solve_row[i] == b ? a * 5 + solve_col[i] : i];
+                break;
+            case 1: // swap columns a and b
+                grid->cell[i] = cell[solve_col[i] == a ? solve_row[i] * 5 + b : solve_col[i] == b ? solve_row[i] * 5 + a : i];
+                break;
+            case 2: // reverse the rows
+                grid->cell[i] = cell[(4 - solve_row[i]) * 5 + solve_col[i]];
+                break;
+            case 3: // reverse the columns
+                grid->cell[i] = cell[solve_row[i] * 5 + 4 - solve_col[i]];
+                break;
+            default: // transpose
+                grid->cell[i] = cell[solve_col[i] * 5 + solve_row[i]];
+                break;
+            }
+        }
+    }
+    solve_index(grid);
+
+    return;
+}
+
+/*
+* decrypts size letter codes of text under grid into plain and returns its quadgram score. the digram rules work on
+* the positions through solve_digram, so a candidate key costs no setup beyond its position index and no branches
+*/
+static double solve_score(const struct solve_grid *grid, const uint8_t *text, uint8_t *plain, size_t size,
+                          const float *model){
+    const uint8_t *digram;
+    float sum[2] = {0, 0};
+    size_t i;
+
+    for(i = 0; i < size; i += 2){
+        digram = solve_digram[grid->pos[text[i]] * 25 + grid->pos[text[i + 1]]];
+        plain[i] = grid->cell[digram[0]];
+        plain[i + 1] = grid->cell[digram[1]];
+    }
+
+    // every quadgram index is built from the letters themselves and summed into its own lane, so nothing waits
+    // on the previous quadgram
+    for(i = 3; i + 1 < size; i += 2){
+        sum[0] += model[((plain[i - 3] * 26 + plain[i - 2]) * 26 + plain[i - 1]) * 26 + plain[i]];
+        sum[1] += model[((plain[i - 2] * 26 + plain[i - 1]) * 26 + plain[i]) * 26 + plain[i + 1]];
+    }
+    for(; i < size; i++)
+        sum[0] += model[((plain[i - 3] * 26 + plain[i - 2]) * 26 + plain[i - 1]) * 26 + plain[i]];
+
+    return (double)sum[0] + sum[1];
+}
+
+/*
+* runs one annealing chain from a random grid: the temperature falls to 0 in params->rounds even steps and each of
+* them tries params->trials moves, a better key is always taken and a worse one with probability exp(difference / temperature)
+*/
+static void solve_chain_run(void *arg, size_t chunk){
+    struct solve_job *job = (struct solve_job*)arg;
+    struct solve_chain *chain = &job->chains[chunk];
+    struct solve_grid parent, child;
+    uint8_t *plain = job->plain + chunk * job->size, tmp;
+    uint64_t state, keys = 0;
+    double temperature, score, candidate;
+    int i, j, round, trial;
+
+    // xorshift must not start at zero
+    state = job->params->seed + (chunk + 1) * 0x9e3779b97f4a7c15ull;
+    if(state == 0)
+        state = 1;
+
+    // random grid of the 25 letters without I
+    for(i = 0, j = 0; i < 26; i++){
+        if(i != SOLVE_LETTER_I)
+            parent.cell[j++] = i;
+    }
+    for(i = 24; i > 0; i--){
+        j = solve_below(&state, i + 1);
+        tmp = parent.cell[i];
+        parent.cell[i] = parent.cell[j];
+        parent.cell[j] = tmp;
+    }
+    solve_index(&parent);
+
+    score = solve_score(&parent, job->text, plain, job->size, job->model);
+    chain->best = parent;
+    chain->score = score;
+
+    for(round = 0; round < job->params->rounds; round++){
+        temperature = job->params->temperature * (job->params->rounds - round) / job->params->rounds;
+        for(trial = 0; trial < job->params->trials; trial++){
+            child = parent;
+            solve_move(&child, &state);
+            candidate = solve_score(&child, job->text, plain, job->size, job->model);
+            keys++;
+
+            if(candidate > score ||
+               exp((candidate - score) / temperature) > (solve_random(&state) >> 11) * (1.0 / (1ull << 53))){
+                parent = child;
+                score = candidate;
+                if(score > chain->score){
+                    chain->best = parent;
+                    chain->score = score;
+                }
+            }
+        }
+    }
+    chain->keys = keys;
+
+    return;
+}
+
+/*
+* recovers the playfair key of length bytes of ciphertext by simulated annealing over the 5x5 grid, scoring every
+* candidate's decryption with model. params->chains independent chains run across the pool (NULL runs them on the
+* calling thread), the best key of all of them is stored in result with tables set. returns 0, or -1 if the
+* ciphertext has fewer than 4 letters or memory ran out
+*/
+int playfair_solve(crypto_pool *pool, uint8_t *ciphertext, const quadgram_model *model,
+                   const playfair_solve_params *params, playfair_solve_result *result, size_t length){
+    playfair_solve_params run;
+    struct solve_job job;
+    struct timespec start, end;
+    uint8_t *text, *rows[5], grid[25];
+    size_t i, size = 0, chunk;
+    int c, best;
+
+    pthread_once(&solve_once, solve_digram_init);
+
+    run = *params;
+    if(run.chains <= 0)
+        run.chains = pool != NULL ? crypto_pool_threads(pool) : 1;
+    if(run.trials <= 0)
+        run.trials = PLAYFAIR_SOLVE_TRIALS;
+    if(run.rounds <= 0)
+        run.rounds = PLAYFAIR_SOLVE_ROUNDS;
+
+    // the ciphertext letters as codes, in whole digrams
+    text = (uint8_t*)arena_get(length + 1);
+    if(text == NULL)
+        return -1;
+    for(i = 0; i < length; i++){
+        c = quadgram_letter(ciphertext[i]);
+        if(c != 26)
+            text[size++] = c;
+    }
+    size &= ~(size_t)1;
+    if(size < 4){
+        arena_put(text, length + 1);
+        return -1;
+    }
+    if(run.temperature <= 0)
+        run.temperature = SOLVE_TEMP_LETTER * size;
+    if(run.temperature < SOLVE_TEMP_MIN)
+        run.temperature = SOLVE_TEMP_MIN;
+
+    job.text = text;
+    job.size = size;
+    job.model = model->score;
+    job.params = &run;
+    job.plain = (uint8_t*)arena_get(run.chains * size);
+    job.chains = (struct solve_chain*)arena_get(run.chains * sizeof(struct solve_chain));
+    if(job.plain == NULL || job.chains == NULL){
+        arena_put(job.chains, run.chains * sizeof(struct solve_chain));
+        arena_put(job.plain, run.chains * size);
+        arena_put(text, length + 1);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if(pool == NULL || crypto_pool_threads(pool) <= 1){
+        for(chunk = 0; chunk < (size_t)run.chains; chunk++)
+            solve_chain_run(&job, chunk);
+    }else{
+        pool_run(pool, run.chains, solve_chain_run, &job);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // best chain wins, its grid back to letters
+    result->keys = 0;
+    for(c = 0, best = 0; c < run.chains; c++){
+        result->keys += job.chains[c].keys;
+        if(job.chains[c].score > job.chains[best].score)
+            best = c;
+    }
+    for(i = 0; i < 25; i++)
+        grid[i] = 'A' + job.chains[best].best.cell[i];
+    for(i = 0; i < 5; i++)
+        rows[i] = grid + (i * 5);
+    playfair_key_from_matrix(&result->key, rows, 1);
+    result->score = job.chains[best].score / (size - 3);
+    result->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    arena_put(job.chains, run.chains * sizeof(struct solve_chain));
+    arena_put(job.plain, run.chains * size);
+    arena_put(text, length + 1);
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "crypto.h"
+#include "stats.h"
+
+static const char *stats_names[CRYPTO_STATS_CIPHERS] = {"caesar", "affine", "otp", "feistel", "playfair", "keygen"};
+
+#ifdef CRYPTO_STATS
+
+__thread struct stats_block *stats_local;
+
+// every block ever registered, blocks of exited threads stay so their counts are not lost
+static struct stats_block *stats_blocks;
+
+// what the blocks added up to at the last reset, subtracted on read so reset never writes another thread's block
+static crypto_stats stats_base[CRYPTO_STATS_CIPHERS];
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+* returns the calling thread's block, registering it on first use. NULL if it could not be allocated
+*/
+struct stats_block *stats_thread(void){
+    struct stats_block *block;
+
+    block = (struct stats_block*)calloc(1, sizeof(struct stats_block));
+    if(block == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&stats_lock);
+    block->next = stats_blocks;
+    stats_blocks = block;
+    pthread_mutex_unlock(&stats_lock);
+
+    stats_local = block;
+
+    return block;
+}
+
+/*
+* adds the counters of every thread for cipher into sum, called with stats_lock held
+*/
+static void stats_sum(int cipher, crypto_stats *sum){
+    struct stats_block *block;
+    const crypto_stats *c;
+    int phase;
+
+    memset(sum, 0, sizeof(crypto_stats));
+    for(block = stats_blocks; block != NULL; block = block->next){
+        c = &block->counters[cipher];
+        sum->calls += __atomic_load_n(&c->calls, __ATOMIC_RELAXED);
+        sum->bytes_in += __atomic_load_n(&c->bytes_in, __ATOMIC_RELAXED);
+        sum->bytes_out += __atomic_load_n(&c->bytes_out, __ATOMIC_RELAXED);
+        sum->allocs += __atomic_load_n(&c->allocs, __ATOMIC_RELAXED);
+        sum->alloc_bytes += __atomic_load_n(&c->alloc_bytes, __ATOMIC_RELAXED);
+        for(phase = 0; phase < CRYPTO_PHASES; phase++)
+            sum->ns[phase] += __atomic_load_n(&c->ns[phase], __ATOMIC_RELAXED);
+    }
+
+    return;
+}
+
+#endif
+
+/*
+* returns 1 if the library was built with CRYPTO_STATS and counts, 0 if every counter stays zero
+*/
+int crypto_stats_enabled(void){
+#ifdef CRYPTO_STATS
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/*
+* stores the counters of cipher (one of CRYPTO_STATS_*) added up over every thread since the last reset
+*/
+void crypto_stats_get(int cipher, crypto_stats *stats){
+#ifdef CRYPTO_STATS
+    const crypto_stats *base = &stats_base[cipher];
+    int phase;
+
+    pthread_mutex_lock(&stats_lock);
+    stats_sum(cipher, stats);
+    stats->calls -= base->calls;
+    stats->bytes_in -= base->bytes_in;
+    stats->bytes_out -= base->bytes_out;
+    stats->allocs -= base->allocs;
+    stats->alloc_bytes -= base->alloc_bytes;
+    for(phase = 0; phase < CRYPTO_PHASES; phase++)
+        stats->ns[phase] -= base->ns[phase];
+    pthread_mutex_unlock(&stats_lock);
+#else
+    memset(stats, 0, sizeof(crypto_stats));
+#endif
+
+    return;
+}
+
+/*
+* starts every counter of every cipher over from zero
+*/
+void crypto_stats_reset(void){
+#ifdef CRYPTO_STATS
+    int cipher;
+
+    pthread_mutex_lock(&stats_lock);
+    for(cipher = 0; cipher < CRYPTO_STATS_CIPHERS; cipher++)
+        stats_sum(cipher, &stats_base[cipher]);
+    pthread_mutex_unlock(&stats_lock);
+#endif
+
+    return;
+}
+
+/*
+* returns the name of cipher (one of CRYPTO_STATS_*)
+*/
+const char *crypto_stats_name(int cipher){
+    if(cipher < 0 || cipher >= CRYPTO_STATS_CIPHERS)
+        return "unknown";
+
+    return stats_names[cipher];
+}
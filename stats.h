@@ -0,0 +1,92 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdint.h>
+#include <time.h>
+#include "crypto.h"
+
+/*
+* instrumentation hooks of the library, built with -DCRYPTO_STATS (make STATS=1) and empty otherwise.
+* every thread counts into its own block and crypto_stats_get adds the blocks up, so counting takes no lock
+* and no atomic read-modify-write
+*/
+#ifdef CRYPTO_STATS
+
+// the counters of one thread, linked into the list crypto_stats_get walks
+struct stats_block {
+    crypto_stats counters[CRYPTO_STATS_CIPHERS];
+    struct stats_block *next;
+};
+
+extern __thread struct stats_block *stats_local;
+
+/*
+* returns the calling thread's block, registering it on first use. NULL if it could not be allocated
+*/
+struct stats_block *stats_thread(void);
+
+/*
+* adds v to a counter only the calling thread writes, atomic loads and stores keep readers race free
+*/
+static inline void stats_add(uint64_t *counter, uint64_t v){
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + v, __ATOMIC_RELAXED);
+}
+
+static inline crypto_stats *stats_counters(int cipher){
+    struct stats_block *block = stats_local ? stats_local : stats_thread();
+
+    return block ? &block->counters[cipher] : NULL;
+}
+
+static inline uint64_t stats_clock(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static inline void stats_call(int cipher, size_t in, size_t out){
+    crypto_stats *stats = stats_counters(cipher);
+
+    if(stats){
+        stats_add(&stats->calls, 1);
+        stats_add(&stats->bytes_in, in);
+        stats_add(&stats->bytes_out, out);
+    }
+}
+
+static inline void stats_alloc(int cipher, size_t size){
+    crypto_stats *stats = stats_counters(cipher);
+
+    if(stats){
+        stats_add(&stats->allocs, 1);
+        stats_add(&stats->alloc_bytes, size);
+    }
+}
+
+// charges the time since *start to phase and restarts the clock for the next phase
+static inline void stats_phase(int cipher, int phase, uint64_t *start){
+    crypto_stats *stats = stats_counters(cipher);
+    uint64_t now = stats_clock();
+
+    if(stats)
+        stats_add(&stats->ns[phase], now - *start);
+    *start = now;
+}
+
+#define STATS_START(T)                  uint64_t T = stats_clock()
+#define STATS_PHASE(CIPHER, PHASE, T)   stats_phase(CIPHER, PHASE, &T)
+#define STATS_CALL(CIPHER, IN, OUT)     stats_call(CIPHER, IN, OUT)
+#define STATS_ALLOC(CIPHER, SIZE)       stats_alloc(CIPHER, SIZE)
+
+#else
+
+#define STATS_START(T)                  ((void)0)
+#define STATS_PHASE(CIPHER, PHASE, T)   ((void)0)
+#define STATS_CALL(CIPHER, IN, OUT)     ((void)0)
+#define STATS_ALLOC(CIPHER, SIZE)       ((void)0)
+
+#endif
+
+#endif